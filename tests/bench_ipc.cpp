@@ -0,0 +1,66 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_ipc_protocol.h"
+#include "umapita_ipc_transport.h"
+#include "umapita_ipc_server.h"
+#include "unix_socket_transport.h"
+
+using namespace Umapita::Ipc;
+
+//
+// IPC の往復レイテンシ
+//
+// Unix ドメインソケット越しに Server と往復する時間と、コーデックだけの時間を測る。
+// 名前付きパイプの実測ではないが、Server 側（デコード・ロック・エンコード）の割合の目安になる。
+//
+int main(int argc, char **argv) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+  using Clock = std::chrono::steady_clock;
+  auto us = [](Clock::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+
+  auto owned = std::make_unique<UnixSocketTransport>();
+  auto &transport = *owned;
+  Server::Handler handler;
+  handler.is_profile_existing = [](const std::u16string &) { return true; };
+  Server server{std::move(owned), std::move(handler)};
+  Status s;
+  s.hasTarget = true;
+  s.profileName = u"default";
+  server.publish(s, Metrics{});
+
+  UnixSocketClient client{transport};
+  StatusCode status;
+  Buffer payload;
+  for (int i=0; i<1000; i++)
+    client.request(Opcode::GetStatus, {}, status, payload);
+
+  for (auto opcode : {Opcode::GetStatus, Opcode::GetMetrics}) {
+    std::vector<double> samples;
+    samples.reserve(rounds);
+    for (int i=0; i<rounds; i++) {
+      auto start = Clock::now();
+      if (!client.request(opcode, {}, status, payload) || status != StatusCode::Ok) {
+        std::fprintf(stderr, "request failed\n");
+        return EXIT_FAILURE;
+      }
+      samples.push_back(us(Clock::now() - start));
+    }
+    Test::report(opcode == Opcode::GetStatus ? "round trip get-status" : "round trip get-metrics", samples, "us");
+  }
+
+  std::vector<double> samples;
+  samples.reserve(rounds);
+  for (int i=0; i<rounds; i++) {
+    auto start = Clock::now();
+    auto buf = encode_message(0, encode_status(s));
+    Header h;
+    std::uint8_t raw[HEADER_SIZE];
+    std::copy(buf.begin(), buf.begin() + HEADER_SIZE, raw);
+    Status d;
+    if (!decode_header(raw, h) || !decode_status(Buffer(buf.begin() + HEADER_SIZE, buf.end()), d))
+      return EXIT_FAILURE;
+    samples.push_back(us(Clock::now() - start));
+  }
+  Test::report("codec only status encode+decode", samples, "us");
+  return EXIT_SUCCESS;
+}
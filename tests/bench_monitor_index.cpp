@@ -0,0 +1,66 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_monitor_index.h"
+#include "monitor_layouts.h"
+
+using Umapita::MonitorIndex;
+using namespace MonitorLayouts;
+
+//
+// MonitorIndex と線形探索の比較
+//
+// モニタ枚数ごとに、同じ問い合わせ列を格子・線形探索・既定（枚数で切り替え）で引いて 1 回あたりの時間を比べる。
+// MonitorIndex::LINEAR_SCAN_LIMIT はこの結果で決めている。
+//
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+double ns_per_query(std::size_t queries, Fn fn) {
+  // 結果を捨てさせない
+  volatile int sink = 0;
+  auto start = Clock::now();
+  for (std::size_t i=0; i<queries; i++)
+    sink = sink + fn(i);
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::size_t queries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::mt19937 rng{42};
+
+  std::printf("%-8s %-24s %10s %10s %10s\n", "monitors", "query", "grid(ns)", "linear(ns)", "default(ns)");
+  for (int count : {1, 2, 4, 8, 16, 24, 32, 48, 64}) {
+    auto rects = row_layout(count);
+    MonitorIndex grid{rects, 0}, index{rects};
+    LONG width = count * 1920;
+    std::uniform_int_distribution<LONG> xs{-100, width + 100}, ys{-100, 1180};
+    std::vector<POINT> points(queries);
+    std::vector<RECT> boxes(queries);
+    for (std::size_t i=0; i<queries; i++) {
+      points[i] = POINT{xs(rng), ys(rng)};
+      auto x = xs(rng), y = ys(rng);
+      boxes[i] = RECT{x, y, x + 1280, y + 720};
+    }
+
+    auto report = [count](const char *name, double a, double b, double c) {
+                    std::printf("%-8d %-24s %10.1f %10.1f %10.1f\n", count, name, a, b, c);
+                  };
+    report("find_by_point",
+           ns_per_query(queries, [&](std::size_t i) { return grid.find_by_point(points[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return linear_find_by_point(rects, points[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return index.find_by_point(points[i]); }));
+    report("find_by_containment",
+           ns_per_query(queries, [&](std::size_t i) { return grid.find_by_containment(boxes[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return linear_find_by_containment(rects, boxes[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return index.find_by_containment(boxes[i]); }));
+    report("find_by_largest_overlap",
+           ns_per_query(queries, [&](std::size_t i) { return grid.find_by_largest_overlap(boxes[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return linear_find_by_largest_overlap(rects, boxes[i]); }),
+           ns_per_query(queries, [&](std::size_t i) { return index.find_by_largest_overlap(boxes[i]); }));
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_tiling_solver.h"
+#include "tiling_cases.h"
+
+using namespace Umapita;
+using namespace TilingCases;
+
+//
+// Tiling::solve() の時間
+//
+// 配置の候補は 2 * 2^(n-1) 通りなので、タイルの数ごとに 1 回あたりの時間を測る。
+// 配置し直すのはターゲットの状態が変わったときだけなので、MAX_TILES 個でもフレームの間に十分収まればよい。
+//
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+  std::mt19937 rng{42};
+
+  for (std::size_t n=1; n<=Tiling::MAX_TILES; n++) {
+    std::vector<std::vector<Tiling::Tile>> cases;
+    std::vector<RECT> areas;
+    std::vector<std::size_t> kinds;
+    for (std::size_t i=0; i<rounds; i++) {
+      cases.push_back(random_tiles(rng, n, kinds));
+      areas.push_back(random_area(rng));
+    }
+    // 結果を捨てさせない
+    volatile LONG sink = 0;
+    std::vector<double> samples;
+    for (std::size_t i=0; i<rounds; i++) {
+      auto start = Clock::now();
+      auto rects = Tiling::solve(cases[i], areas[i], 0, 0, 0, 0);
+      samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+      sink = sink + (rects.empty() ? 0 : rects.front().left);
+    }
+    auto name = "solve n=" + std::to_string(n);
+    Test::report(name.c_str(), samples, "us");
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+//
+// MonitorIndex のテスト・ベンチマーク用のモニタ配置と、比較用の線形探索
+//
+namespace MonitorLayouts {
+
+// 3x3 の格子のセルに一枚ずつ置く。セルを埋めるものと隙間を空けるものを混ぜ、負の座標も含める
+inline std::vector<RECT> random_layout(std::mt19937 &rng, int count) {
+  constexpr LONG CELL = 4000;
+  std::vector<int> cells(9);
+  std::iota(cells.begin(), cells.end(), 0);
+  std::shuffle(cells.begin(), cells.end(), rng);
+  std::uniform_int_distribution<LONG> size{640, CELL}, coin{0, 1};
+  std::vector<RECT> rects;
+  for (int i=0; i<count && i<9; i++) {
+    LONG left = (cells[i] % 3 - 1) * CELL, top = (cells[i] / 3 - 1) * CELL;
+    if (coin(rng)) {
+      rects.push_back(RECT{left, top, left + CELL, top + CELL});
+      continue;
+    }
+    auto w = size(rng), h = size(rng);
+    auto dx = std::uniform_int_distribution<LONG>{0, CELL - w}(rng), dy = std::uniform_int_distribution<LONG>{0, CELL - h}(rng);
+    rects.push_back(RECT{left + dx, top + dy, left + dx + w, top + dy + h});
+  }
+  return rects;
+}
+
+// random_layout に、既存のモニタと同じ矩形（ミラーリング）や一部だけ重なる矩形を足す
+inline std::vector<RECT> random_overlapping_layout(std::mt19937 &rng, int count) {
+  auto rects = random_layout(rng, count);
+  std::uniform_int_distribution<LONG> shift{-2000, 2000}, coin{0, 1};
+  for (int i=0; i<count; i++) {
+    auto base = rects[std::uniform_int_distribution<std::size_t>{0, rects.size() - 1}(rng)];
+    if (coin(rng)) {
+      auto dx = shift(rng), dy = shift(rng);
+      base = RECT{base.left + dx, base.top + dy, base.right + dx, base.bottom + dy};
+    }
+    // 前に入れても後ろに入れても同じ答えになること
+    rects.insert(rects.begin() + std::uniform_int_distribution<std::size_t>{0, rects.size()}(rng), base);
+  }
+  return rects;
+}
+
+// 横一列に並べる（ベンチマーク用）
+inline std::vector<RECT> row_layout(int count) {
+  std::vector<RECT> rects;
+  for (LONG i=0; i<count; i++)
+    rects.push_back(RECT{i * 1920, 0, (i + 1) * 1920, 1080});
+  return rects;
+}
+
+inline bool contains(const RECT &m, POINT pt) {
+  return m.left <= pt.x && pt.x < m.right && m.top <= pt.y && pt.y < m.bottom;
+}
+
+inline int linear_find_by_point(const std::vector<RECT> &rects, POINT pt) {
+  for (int n=0; n<static_cast<int>(rects.size()); n++)
+    if (contains(rects[n], pt))
+      return n;
+  return -1;
+}
+
+inline int linear_find_by_containment(const std::vector<RECT> &rects, const RECT &rc) {
+  if (rc.right <= rc.left || rc.bottom <= rc.top)
+    return -1;
+  for (int n=0; n<static_cast<int>(rects.size()); n++) {
+    auto const &m = rects[n];
+    if (m.left <= rc.left && m.top <= rc.top && rc.right <= m.right && rc.bottom <= m.bottom)
+      return n;
+  }
+  return -1;
+}
+
+inline int linear_find_by_largest_overlap(const std::vector<RECT> &rects, const RECT &rc) {
+  if (rc.right <= rc.left || rc.bottom <= rc.top)
+    return -1;
+  auto best = -1;
+  LONGLONG bestArea = 0;
+  for (int n=0; n<static_cast<int>(rects.size()); n++) {
+    auto const &m = rects[n];
+    LONGLONG w = std::min(m.right, rc.right) - std::max(m.left, rc.left);
+    LONGLONG h = std::min(m.bottom, rc.bottom) - std::max(m.top, rc.top);
+    if (w > 0 && h > 0 && w*h > bestArea) {
+      best = n;
+      bestArea = w*h;
+    }
+  }
+  return best;
+}
+
+inline RECT random_rect(std::mt19937 &rng, LONG lo, LONG hi) {
+  std::uniform_int_distribution<LONG> pos{lo, hi}, size{-100, 3000};
+  auto x = pos(rng), y = pos(rng);
+  return RECT{x, y, x + size(rng), y + size(rng)};
+}
+
+} // namespace MonitorLayouts
@@ -0,0 +1,85 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
+
+using Umapita::ConvergenceGuard;
+
+namespace {
+
+HWND const WINDOW = reinterpret_cast<HWND>(0x1000);
+const RECT IDEAL{0, 0, 1920, 1080};
+const RECT ROUNDED{0, 0, 1920, 1084};  // ゲームが丸めた結果
+const RECT ELSEWHERE{100, 100, 1000, 600};
+
+} // namespace
+
+TEST(settles_when_the_same_request_gives_the_same_result) {
+  ConvergenceGuard g;
+  CHECK(g.should_attempt(WINDOW, IDEAL, ELSEWHERE, 0));
+  g.on_result(ROUNDED);
+  CHECK(g.state() == ConvergenceGuard::Converging);
+  CHECK(!g.should_attempt(WINDOW, IDEAL, ROUNDED, 100));
+  CHECK(g.state() == ConvergenceGuard::Settled);
+}
+
+TEST(backs_off_when_placement_keeps_being_undone) {
+  ConvergenceGuard g;
+  ULONGLONG now = 0;
+  auto attempts = 0;
+  // こちらの要求は通るが、すぐに別の位置に戻される
+  while (g.should_attempt(WINDOW, IDEAL, ELSEWHERE, now) && attempts < 10) {
+    g.on_result(IDEAL);
+    g.on_ideal();
+    attempts++;
+    now += 200;
+  }
+  CHECK(attempts < 10);
+  CHECK(g.state() == ConvergenceGuard::BackingOff);
+  CHECK(!g.poll_backoff_expired(now));
+  CHECK(g.backoff_until() > now);
+  CHECK(!g.poll_backoff_expired(g.backoff_until() - 1));
+  CHECK(g.poll_backoff_expired(now + 60000));
+  CHECK(g.state() == ConvergenceGuard::Converging);
+}
+
+// 理想の位置を経てから、以前 Settled した位置にずらされたら、もう一度動かす
+TEST(ideal_position_forgets_the_settled_result) {
+  ConvergenceGuard g;
+  CHECK(g.should_attempt(WINDOW, IDEAL, ELSEWHERE, 0));
+  g.on_result(ROUNDED);
+  CHECK(!g.should_attempt(WINDOW, IDEAL, ROUNDED, 100));
+  CHECK(g.state() == ConvergenceGuard::Settled);
+
+  g.on_ideal();
+  CHECK(g.state() == ConvergenceGuard::Idle);
+  CHECK(g.should_attempt(WINDOW, IDEAL, ROUNDED, 5000));
+}
+
+TEST(ideal_position_does_not_lift_a_backoff) {
+  ConvergenceGuard g;
+  ULONGLONG now = 0;
+  // 丸められた上に、さらに別の位置に戻される
+  while (g.should_attempt(WINDOW, IDEAL, ELSEWHERE, now)) {
+    g.on_result(ROUNDED);
+    now += 10;
+  }
+  CHECK(g.state() == ConvergenceGuard::BackingOff);
+  g.on_ideal();
+  CHECK(g.state() == ConvergenceGuard::BackingOff);
+  CHECK(!g.should_attempt(WINDOW, IDEAL, ELSEWHERE, now));
+}
+
+TEST(new_window_or_request_starts_over) {
+  ConvergenceGuard g;
+  CHECK(g.should_attempt(WINDOW, IDEAL, ELSEWHERE, 0));
+  g.on_result(ROUNDED);
+  CHECK(!g.should_attempt(WINDOW, IDEAL, ROUNDED, 10));
+  CHECK(g.should_attempt(reinterpret_cast<HWND>(0x2000), IDEAL, ROUNDED, 20));
+  g.on_result(ROUNDED);
+  CHECK(g.should_attempt(reinterpret_cast<HWND>(0x2000), ELSEWHERE, ROUNDED, 30));
+}
+
+int main() {
+  return Test::run_all();
+}
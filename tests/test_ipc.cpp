@@ -0,0 +1,304 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_ipc_protocol.h"
+#include "umapita_ipc_transport.h"
+#include "umapita_ipc_server.h"
+#include "unix_socket_transport.h"
+
+using namespace Umapita::Ipc;
+
+namespace {
+
+Buffer header_bytes(std::uint32_t magic, std::uint16_t version, std::uint16_t code, std::uint32_t length) {
+  return encode_header(Header{magic, version, code, length});
+}
+
+bool decode(const Buffer &buf, Header &h) {
+  std::uint8_t raw[HEADER_SIZE];
+  std::copy(buf.begin(), buf.begin() + HEADER_SIZE, raw);
+  return decode_header(raw, h);
+}
+
+Buffer profile_payload(const std::u16string &name) {
+  Buffer buf;
+  Writer{buf}.str(name);
+  return buf;
+}
+
+// テスト用の Server 一式
+struct Fixture {
+  UnixSocketTransport *transport;
+  std::atomic<int> notified{0};
+  std::vector<std::u16string> profiles{u"default", u"横長"};
+  std::unique_ptr<Server> server;
+
+  Fixture() {
+    auto t = std::make_unique<UnixSocketTransport>();
+    transport = t.get();
+    Server::Handler handler;
+    handler.notify = [this] { notified++; };
+    handler.is_profile_existing = [this](const std::u16string &name) {
+                                    return std::find(profiles.begin(), profiles.end(), name) != profiles.end();
+                                  };
+    server = std::make_unique<Server>(std::move(t), std::move(handler));
+  }
+};
+
+} // namespace
+
+//
+// コーデック
+//
+TEST(writer_reader_round_trip) {
+  Buffer buf;
+  Writer w{buf};
+  w.u8(0xAB);
+  w.u16(0xBEEF);
+  w.u32(0xDEADBEEF);
+  w.u64(0x0123456789ABCDEFULL);
+  w.i32(-42);
+  w.str(u"ウマ");
+  CHECK(buf.size() == 1 + 2 + 4 + 8 + 4 + 2 + 4);
+  CHECK(buf[1] == 0xEF && buf[2] == 0xBE);  // リトルエンディアン
+
+  Reader r{buf};
+  CHECK(r.u8() == 0xAB);
+  CHECK(r.u16() == 0xBEEF);
+  CHECK(r.u32() == 0xDEADBEEF);
+  CHECK(r.u64() == 0x0123456789ABCDEFULL);
+  CHECK(r.i32() == -42);
+  CHECK(r.str() == u"ウマ");
+  CHECK(r.ok());
+  CHECK(r.eof());
+}
+
+TEST(reader_fails_sticky_on_truncation) {
+  Buffer buf{0x01, 0x02, 0x03};
+  Reader r{buf};
+  CHECK(r.u16() == 0x0201);
+  r.u32();
+  CHECK(!r.ok());
+  // 一度失敗したら残りがあっても読めない
+  CHECK(r.u8() == 0);
+  CHECK(!r.ok());
+}
+
+TEST(reader_rejects_string_longer_than_buffer) {
+  Buffer buf;
+  Writer{buf}.u16(3);
+  Writer{buf}.u16('a');
+  Reader r{buf};
+  CHECK(r.str().empty());
+  CHECK(!r.ok());
+}
+
+TEST(header_round_trip) {
+  auto buf = header_bytes(MAGIC, VERSION, static_cast<std::uint16_t>(Opcode::GetStatus), 17);
+  CHECK(buf.size() == HEADER_SIZE);
+  Header h;
+  CHECK(decode(buf, h));
+  CHECK(h.magic == MAGIC);
+  CHECK(h.version == VERSION);
+  CHECK(h.code == static_cast<std::uint16_t>(Opcode::GetStatus));
+  CHECK(h.length == 17);
+}
+
+TEST(header_rejects_bad_magic_version_and_length) {
+  Header h;
+  CHECK(!decode(header_bytes(MAGIC ^ 1, VERSION, 1, 0), h));
+  CHECK(!decode(header_bytes(MAGIC, VERSION + 1, 1, 0), h));
+  CHECK(decode(header_bytes(MAGIC, VERSION, 1, MAX_PAYLOAD_SIZE), h));
+  CHECK(!decode(header_bytes(MAGIC, VERSION, 1, MAX_PAYLOAD_SIZE + 1), h));
+  CHECK(!decode(header_bytes(MAGIC, VERSION, 1, 0xFFFFFFFF), h));
+}
+
+TEST(status_round_trip) {
+  Status s;
+  s.hasTarget = true;
+  s.isEnabled = true;
+  s.isFocusOn = false;
+  s.isHorizontal = true;
+  const std::int32_t wr[] = {-1920, 0, -960, 540}, cr[] = {-1912, 31, -968, 532};
+  std::copy(std::begin(wr), std::end(wr), s.windowRect);
+  std::copy(std::begin(cr), std::end(cr), s.clientRect);
+  s.profileName = u"横長";
+
+  Status d;
+  CHECK(decode_status(encode_status(s), d));
+  CHECK(d.hasTarget && d.isEnabled && !d.isFocusOn && d.isHorizontal);
+  CHECK(std::equal(std::begin(wr), std::end(wr), d.windowRect));
+  CHECK(std::equal(std::begin(cr), std::end(cr), d.clientRect));
+  CHECK(d.profileName == s.profileName);
+}
+
+TEST(status_rejects_trailing_and_truncated_bytes) {
+  auto buf = encode_status(Status{});
+  Status d;
+  auto longer = buf;
+  longer.push_back(0);
+  CHECK(!decode_status(longer, d));
+  auto shorter = buf;
+  shorter.pop_back();
+  CHECK(!decode_status(shorter, d));
+}
+
+TEST(metrics_round_trip) {
+  Metrics m;
+  m.ticks = 1;
+  m.statusChanges = 2;
+  m.hotKeyRegisterCalls = 3;
+  m.hotKeyUnregisterCalls = 4;
+  m.hotKeyRegisterFailures = 5;
+  m.hotKeyDispatches = 6;
+  m.ipcRequests = 0x100000000ULL;
+  Metrics d;
+  CHECK(decode_metrics(encode_metrics(m), d));
+  CHECK(d.ticks == 1 && d.statusChanges == 2 && d.hotKeyRegisterCalls == 3 && d.hotKeyUnregisterCalls == 4);
+  CHECK(d.hotKeyRegisterFailures == 5 && d.hotKeyDispatches == 6 && d.ipcRequests == 0x100000000ULL);
+}
+
+TEST(metrics_tolerates_extra_counters_but_not_bad_count) {
+  Buffer buf;
+  Writer w{buf};
+  w.u32(8);
+  for (std::uint64_t i=0; i<8; i++)
+    w.u64(i + 10);
+  Metrics d;
+  CHECK(decode_metrics(buf, d));
+  CHECK(d.ticks == 10 && d.ipcRequests == 16);
+
+  buf.pop_back();
+  CHECK(!decode_metrics(buf, d));
+}
+
+//
+// Server（Unix ドメインソケット越し）
+//
+TEST(server_returns_published_status_and_metrics) {
+  Fixture f;
+  Status s;
+  s.hasTarget = true;
+  s.profileName = u"default";
+  Metrics m;
+  m.ticks = 123;
+  f.server->publish(s, m);
+
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  CHECK(client.request(Opcode::GetStatus, {}, status, payload));
+  CHECK(status == StatusCode::Ok);
+  Status d;
+  CHECK(decode_status(payload, d));
+  CHECK(d.hasTarget && d.profileName == u"default");
+
+  CHECK(client.request(Opcode::GetMetrics, {}, status, payload));
+  Metrics dm;
+  CHECK(decode_metrics(payload, dm));
+  CHECK(dm.ticks == 123);
+  CHECK(dm.ipcRequests == 2);
+}
+
+TEST(server_queues_commands_and_notifies) {
+  Fixture f;
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  CHECK(client.request(Opcode::SwitchProfile, profile_payload(u"横長"), status, payload));
+  CHECK(status == StatusCode::Accepted);
+  CHECK(client.request(Opcode::ApplyNow, {}, status, payload));
+  CHECK(status == StatusCode::Accepted);
+  CHECK(f.notified == 2);
+
+  Server::Command command;
+  CHECK(f.server->pop_command(command));
+  CHECK(command.kind == Server::Command::SwitchProfile && command.profileName == u"横長");
+  CHECK(f.server->pop_command(command));
+  CHECK(command.kind == Server::Command::ApplyNow);
+  CHECK(!f.server->pop_command(command));
+}
+
+TEST(server_rejects_bad_requests_without_queueing) {
+  Fixture f;
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  CHECK(client.request(Opcode::SwitchProfile, profile_payload(u"missing"), status, payload));
+  CHECK(status == StatusCode::NotFound);
+  CHECK(client.request(Opcode::SwitchProfile, profile_payload(u""), status, payload));
+  CHECK(status == StatusCode::BadRequest);
+  auto trailing = profile_payload(u"default");
+  trailing.push_back(0);
+  CHECK(client.request(Opcode::SwitchProfile, trailing, status, payload));
+  CHECK(status == StatusCode::BadRequest);
+  CHECK(client.request(static_cast<Opcode>(99), {}, status, payload));
+  CHECK(status == StatusCode::UnknownOpcode);
+
+  Server::Command command;
+  CHECK(!f.server->pop_command(command));
+  CHECK(f.notified == 0);
+}
+
+TEST(server_closes_connection_on_malformed_header) {
+  Fixture f;
+  {
+    UnixSocketClient client{*f.transport};
+    CHECK(client.send_raw(header_bytes(MAGIC ^ 0xFF, VERSION, 1, 0)));
+    Header h;
+    Buffer payload;
+    CHECK(client.receive(h, payload));
+    CHECK(h.code == static_cast<std::uint16_t>(StatusCode::BadRequest));
+    CHECK(client.is_closed_by_peer());
+  }
+  // 次の接続は普通に受け付ける
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  CHECK(client.request(Opcode::GetStatus, {}, status, payload));
+  CHECK(status == StatusCode::Ok);
+}
+
+TEST(server_retries_after_transport_failure_and_stops_promptly) {
+  Fixture f;
+  f.transport->fail_next_accept();
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  // 再試行の前に一度待つので、そのぶん遅れて応答する
+  CHECK(client.request(Opcode::GetStatus, {}, status, payload));
+  CHECK(status == StatusCode::Ok);
+
+  // 接続したまま止めても、読み込みの途中から抜ける
+  auto start = std::chrono::steady_clock::now();
+  f.server.reset();
+  CHECK(std::chrono::steady_clock::now() - start < Server::RETRY_INTERVAL);
+  CHECK(client.is_closed_by_peer());
+}
+
+// 応答を読まず閉じもしないクライアントがいても、IO_TIMEOUT で見切って次の接続に移り、止めるときはすぐ止まる
+TEST(server_gives_up_on_client_that_stops_reading) {
+  using Clock = std::chrono::steady_clock;
+  Fixture f;
+  UnixSocketClient stuck{*f.transport};
+  CHECK(stuck.send_raw(header_bytes(MAGIC ^ 0xFF, VERSION, 1, 0)));
+
+  auto start = Clock::now();
+  UnixSocketClient client{*f.transport};
+  StatusCode status;
+  Buffer payload;
+  CHECK(client.request(Opcode::GetStatus, {}, status, payload));
+  CHECK(status == StatusCode::Ok);
+  CHECK(Clock::now() - start < IO_TIMEOUT + std::chrono::milliseconds{500});
+
+  // もう一度読まないクライアントを作り、待っている途中で止める
+  UnixSocketClient stuck2{*f.transport};
+  CHECK(stuck2.send_raw(header_bytes(MAGIC ^ 0xFF, VERSION, 1, 0)));
+  std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  start = Clock::now();
+  f.server.reset();
+  CHECK(Clock::now() - start < IO_TIMEOUT);
+}
+
+int main() {
+  return Test::run_all();
+}
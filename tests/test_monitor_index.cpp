@@ -0,0 +1,90 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_monitor_index.h"
+#include "monitor_layouts.h"
+
+using Umapita::MonitorIndex;
+using namespace MonitorLayouts;
+
+namespace {
+
+// 格子を使う場合と線形探索する場合の両方で確かめる
+const std::size_t LIMITS[] = {0, MonitorIndex::LINEAR_SCAN_LIMIT};
+
+} // namespace
+
+TEST(empty_index_finds_nothing) {
+  MonitorIndex index;
+  CHECK(index.find_by_point(POINT{0, 0}) == -1);
+  CHECK(index.find_by_containment(RECT{0, 0, 10, 10}) == -1);
+  CHECK(index.find_by_largest_overlap(RECT{0, 0, 10, 10}) == -1);
+}
+
+TEST(edges_are_half_open) {
+  for (auto limit : LIMITS) {
+    MonitorIndex index{{RECT{0, 0, 1920, 1080}, RECT{1920, 0, 3840, 1080}}, limit};
+    CHECK(index.find_by_point(POINT{0, 0}) == 0);
+    CHECK(index.find_by_point(POINT{1919, 1079}) == 0);
+    CHECK(index.find_by_point(POINT{1920, 0}) == 1);
+    CHECK(index.find_by_point(POINT{3840, 0}) == -1);
+    CHECK(index.find_by_point(POINT{0, 1080}) == -1);
+    CHECK(index.find_by_point(POINT{-1, 0}) == -1);
+    // 境界をまたぐ矩形はどちらにも含まれず、広くかかっている方になる
+    CHECK(index.find_by_containment(RECT{1900, 0, 1940, 10}) == -1);
+    CHECK(index.find_by_largest_overlap(RECT{1900, 0, 1950, 10}) == 1);
+    CHECK(index.find_by_largest_overlap(RECT{1900, 0, 1940, 10}) == 0);  // 同じ面積なら若い方
+  }
+}
+
+TEST(mirrored_monitors_prefer_lower_number) {
+  for (auto limit : LIMITS) {
+    MonitorIndex index{{RECT{0, 0, 1920, 1080}, RECT{0, 0, 1920, 1080}}, limit};
+    CHECK(index.find_by_point(POINT{100, 100}) == 0);
+    CHECK(index.find_by_containment(RECT{10, 10, 20, 20}) == 0);
+    CHECK(index.find_by_largest_overlap(RECT{-10, -10, 20, 20}) == 0);
+  }
+}
+
+// 左上の点を覆う若い番号のモニタには収まらなくても、同じ点を覆う別のモニタに収まれば見つける
+TEST(containment_checks_every_overlapping_monitor) {
+  for (auto limit : LIMITS) {
+    MonitorIndex index{{RECT{0, 0, 1920, 1080}, RECT{1000, 0, 2920, 1080}, RECT{3000, 0, 4000, 1000}}, limit};
+    CHECK(index.find_by_point(POINT{1500, 500}) == 0);
+    CHECK(index.find_by_containment(RECT{1500, 100, 2500, 200}) == 1);
+    CHECK(index.find_by_largest_overlap(RECT{1500, 100, 2500, 200}) == 1);
+    CHECK(index.find_by_largest_overlap(RECT{1000, 100, 1920, 200}) == 0);
+  }
+}
+
+TEST(degenerate_rects_find_nothing) {
+  for (auto limit : LIMITS) {
+    MonitorIndex index{{RECT{0, 0, 1920, 1080}}, limit};
+    CHECK(index.find_by_containment(RECT{10, 10, 10, 20}) == -1);
+    CHECK(index.find_by_largest_overlap(RECT{10, 20, 20, 10}) == -1);
+  }
+}
+
+// 重なっていてもいなくても、どの検索も線形探索と同じ答えになる
+TEST(matches_linear_scan_on_random_layouts) {
+  std::mt19937 rng{12345};
+  int mismatches = 0;
+  for (int layout=0; layout<2000; layout++) {
+    auto count = 1 + layout % 9;
+    auto rects = layout % 4 < 2 ? random_layout(rng, count) : random_overlapping_layout(rng, count);
+    MonitorIndex index{rects, LIMITS[layout % 2]};
+    std::uniform_int_distribution<LONG> pos{-7000, 7000};
+    for (int q=0; q<200; q++) {
+      POINT pt{pos(rng), pos(rng)};
+      auto rc = random_rect(rng, -7000, 7000);
+      if (index.find_by_point(pt) != linear_find_by_point(rects, pt) ||
+          index.find_by_containment(rc) != linear_find_by_containment(rects, rc) ||
+          index.find_by_largest_overlap(rc) != linear_find_by_largest_overlap(rects, rc))
+        mismatches++;
+    }
+  }
+  CHECK(mismatches == 0);
+}
+
+int main() {
+  return Test::run_all();
+}
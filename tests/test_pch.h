@@ -0,0 +1,58 @@
+//
+// テスト・ベンチマーク用の共通ヘッダ
+//
+// 本体の pch.h の代わり。テストするヘッダは標準ライブラリだけで書いてあるので、Windows がなくてもビルドできる。
+// 本体の型のうちテストに出てくるものだけ、最低限の代用品を置いておく。
+//
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+using LONG = std::int32_t;
+using LONGLONG = std::int64_t;
+struct POINT { LONG x, y; };
+struct RECT { LONG left, top, right, bottom; };
+
+using ULONGLONG = std::uint64_t;
+using HWND = struct HWND__ *;
+#define TEXT(s) s
+
+namespace AM::Win32 {
+using StrPtr = const wchar_t *;
+namespace Op {
+inline bool operator == (const RECT &lhs, const RECT &rhs) {
+  return lhs.left == rhs.left && lhs.top == rhs.top && lhs.right == rhs.right && lhs.bottom == rhs.bottom;
+}
+} // namespace Op
+} // namespace AM::Win32
+
+// ログは捨てる
+namespace AM::Log {
+template <typename ...Args> void debug(const char *, Args...) { }
+template <typename ...Args> void info(const char *, Args...) { }
+template <typename ...Args> void warning(const char *, Args...) { }
+template <typename ...Args> void error(const char *, Args...) { }
+} // namespace AM::Log
+#endif
@@ -0,0 +1,140 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_perf_counters.h"
+
+using namespace Umapita;
+
+namespace {
+
+// values[k] = base + k になるように数える。読めた値がこの形でなければ途中の書き込みを見ている
+Perf::Counters make_counters(std::uint64_t base) {
+  Perf::Counters c;
+  for (std::size_t k=0; k<Perf::NUM_COUNTERS; k++)
+    c.values[k] = base + k;
+  return c;
+}
+
+bool is_consistent(const Perf::Snapshot &s) {
+  for (std::size_t k=1; k<s.numCounters; k++)
+    if (s.values[k] != s.values[0] + k)
+      return false;
+  return true;
+}
+
+} // namespace
+
+TEST(names_cover_all_counters) {
+  for (auto name : Perf::COUNTER_NAMES)
+    CHECK(name != nullptr && *name);
+}
+
+TEST(publish_then_read) {
+  Perf::Block b;
+  Perf::publish(b, make_counters(100));
+  Perf::Snapshot s;
+  CHECK(Perf::read(b, s));
+  CHECK(s.sequence == 2);
+  CHECK(s.numCounters == Perf::NUM_COUNTERS);
+  CHECK(s.values[0] == 100);
+  CHECK(is_consistent(s));
+}
+
+TEST(read_rejects_foreign_block) {
+  Perf::Snapshot s;
+  Perf::Block badMagic;
+  badMagic.magic ^= 1;
+  CHECK(!Perf::read(badMagic, s));
+  Perf::Block badVersion;
+  badVersion.version++;
+  CHECK(!Perf::read(badVersion, s));
+}
+
+TEST(read_gives_up_while_writer_is_stuck) {
+  Perf::Block b;
+  b.sequence = 1;  // 書き込みの途中で止まっている
+  Perf::Snapshot s;
+  CHECK(!Perf::read(b, s, 10));
+}
+
+TEST(read_honours_num_counters) {
+  Perf::Block b;
+  Perf::publish(b, make_counters(1));
+  Perf::Snapshot s;
+  // 古い書き手（少ない）なら、その分だけ読む
+  b.numCounters = 3;
+  CHECK(Perf::read(b, s));
+  CHECK(s.numCounters == 3);
+  // 壊れた値でも MAX_COUNTERS を超えて読まない
+  b.numCounters = 1000;
+  CHECK(Perf::read(b, s));
+  CHECK(s.numCounters == Perf::MAX_COUNTERS);
+}
+
+TEST(adopt_resets_values_and_keeps_sequence_moving) {
+  Perf::Block b;
+  Perf::publish(b, make_counters(50));
+  Perf::publish(b, make_counters(60));
+  auto before = b.sequence.load();
+  b.processId = 111;
+  Perf::adopt(b, 222);
+  CHECK(b.processId == 222);
+  CHECK(b.sequence.load() > before);
+  CHECK(!(b.sequence.load() & 1));
+  Perf::Snapshot s;
+  CHECK(Perf::read(b, s));
+  CHECK(s.values[0] == 0 && s.values[Perf::NUM_COUNTERS - 1] == 0);
+}
+
+TEST(adopt_recovers_from_writer_dying_mid_publish) {
+  Perf::Block b;
+  b.sequence = 7;
+  b.numCounters = 2;
+  Perf::adopt(b, 1);
+  CHECK(b.sequence.load() == 8);
+  CHECK(b.numCounters == Perf::NUM_COUNTERS);
+  Perf::Snapshot s;
+  CHECK(Perf::read(b, s));
+}
+
+// 書き手が休まず publish している間に読み、途中の値を一度も見ないこと
+TEST(concurrent_reader_never_sees_torn_values) {
+  Perf::Block b;
+  Perf::publish(b, make_counters(0));
+  std::atomic<bool> isDone{false};
+  std::thread writer{[&] {
+                       for (std::uint64_t i=1; i<=200000; i++)
+                         Perf::publish(b, make_counters(i * 1000));
+                       isDone = true;
+                     }};
+  std::uint64_t reads = 0, failures = 0, torn = 0, backwards = 0;
+  std::uint32_t lastSequence = 0;
+  std::uint64_t lastBase = 0;
+  while (!isDone) {
+    Perf::Snapshot s;
+    if (!Perf::read(b, s)) {
+      failures++;
+      continue;
+    }
+    reads++;
+    if (!is_consistent(s))
+      torn++;
+    if (s.sequence < lastSequence || s.values[0] < lastBase)
+      backwards++;
+    lastSequence = s.sequence;
+    lastBase = s.values[0];
+  }
+  writer.join();
+  std::printf("  %lu reads, %lu retries exhausted\n", static_cast<unsigned long>(reads), static_cast<unsigned long>(failures));
+  CHECK(reads > 0);
+  CHECK(torn == 0);
+  CHECK(backwards == 0);
+
+  Perf::Snapshot s;
+  CHECK(Perf::read(b, s));
+  CHECK(s.values[0] == 200000 * 1000);
+  CHECK(s.sequence == 2 * 200001);
+}
+
+int main() {
+  return Test::run_all();
+}
@@ -0,0 +1,298 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_scheduler.h"
+
+using Umapita::Scheduler;
+using Umapita::ManualClock;
+using Time = Scheduler::Time;
+
+namespace {
+
+// next_wake() が言う時刻にだけ起きて run_due() する。実行した時刻を返す
+std::vector<Time> run_by_next_wake(ManualClock &clock, Scheduler &scheduler) {
+  std::vector<Time> wakes;
+  while (auto wake = scheduler.next_wake()) {
+    clock.advance(wake->delay);
+    wakes.push_back(clock.now());
+    scheduler.run_due();
+  }
+  return wakes;
+}
+
+// 段の境目とその前後、それぞれの段の端
+const Time DELAYS[] = {
+  1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 5000,
+  262143, 262144, 262145, 300000, (Time{1} << 24) - 1,
+};
+
+} // namespace
+
+TEST(once_runs_at_its_expiry) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  auto runs = 0;
+  auto id = scheduler.schedule_once(10, 0, [&] { runs++; });
+  CHECK(scheduler.is_scheduled(id));
+  clock.advance(9);
+  CHECK(scheduler.run_due() == 0);
+  clock.advance(1);
+  CHECK(scheduler.run_due() == 1);
+  CHECK(runs == 1);
+  CHECK(!scheduler.is_scheduled(id));
+  CHECK(scheduler.size() == 0);
+  CHECK(!scheduler.next_wake());
+}
+
+// 上の段に置かれた予定が下の段に落ちてきて、ちょうど予定時刻に実行される
+TEST(cascades_across_levels) {
+  for (Time start : {Time{0}, Time{12345}, (Time{1} << 24) - 3}) {
+    ManualClock clock;
+    clock.advance(start);
+    Scheduler scheduler{clock.clock()};
+    std::vector<Time> fired;
+    for (auto delay : DELAYS)
+      scheduler.schedule_once(delay, 0, [&] { fired.push_back(clock.now()); });
+    auto wakes = run_by_next_wake(clock, scheduler);
+    std::vector<Time> expected;
+    for (auto delay : DELAYS)
+      expected.push_back(start + delay);
+    CHECK(fired == expected);
+    // 予定のないところでは起きない
+    CHECK(wakes == expected);
+  }
+}
+
+// 一気に時刻を進めても、途中の段を崩しながら予定時刻の順に実行する
+TEST(large_advance_runs_in_expiry_order) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  std::vector<Time> fired;
+  for (auto it = std::rbegin(DELAYS); it != std::rend(DELAYS); ++it)
+    scheduler.schedule_once(*it, 0, [&, delay = *it] { fired.push_back(delay); });
+  clock.advance(4096);
+  scheduler.run_due();
+  CHECK(fired == std::vector<Time>(std::begin(DELAYS), std::begin(DELAYS) + 9));
+  clock.advance(Time{1} << 24);
+  scheduler.run_due();
+  CHECK(fired == std::vector<Time>(std::begin(DELAYS), std::end(DELAYS)));
+}
+
+// ホイールに収まらない予定は m_overflow に置かれ、周回のたびにホイールへ入れ直される
+TEST(overflow_is_reinserted) {
+  const Time delays[] = {Time{1} << 24, (Time{1} << 24) + 5, (Time{1} << 25) + 4097, (Time{3} << 24) + 7};
+  for (Time start : {Time{0}, Time{777}}) {
+    ManualClock clock;
+    clock.advance(start);
+    Scheduler scheduler{clock.clock()};
+    std::vector<Time> fired;
+    for (auto delay : delays)
+      scheduler.schedule_once(delay, 0, [&] { fired.push_back(clock.now()); });
+    auto wake = scheduler.next_wake();
+    CHECK(wake && wake->delay == delays[0]);
+    run_by_next_wake(clock, scheduler);
+    std::vector<Time> expected;
+    for (auto delay : delays)
+      expected.push_back(start + delay);
+    CHECK(fired == expected);
+  }
+}
+
+// 取り消したものはスロットに残っていても実行されず、next_wake() にも出てこない
+TEST(cancel_is_lazy_but_complete) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  std::vector<Time> fired;
+  std::vector<Scheduler::TaskId> ids;
+  for (auto delay : DELAYS)
+    ids.push_back(scheduler.schedule_once(delay, 0, [&, delay] { fired.push_back(delay); }));
+  std::vector<Time> expected;
+  for (std::size_t i=0; i<ids.size(); i++) {
+    if (i % 2 == 0) {
+      CHECK(scheduler.cancel(ids[i]));
+      CHECK(!scheduler.is_scheduled(ids[i]));
+    } else {
+      expected.push_back(DELAYS[i]);
+    }
+  }
+  CHECK(!scheduler.cancel(ids[0]));
+  CHECK(scheduler.size() == expected.size());
+  auto wake = scheduler.next_wake();
+  CHECK(wake && wake->delay == expected.front());
+  run_by_next_wake(clock, scheduler);
+  CHECK(fired == expected);
+
+  // 全部取り消せば予定なし
+  auto id = scheduler.schedule_once(100, 0, [] { });
+  scheduler.cancel(id);
+  CHECK(!scheduler.next_wake());
+}
+
+TEST(task_can_cancel_others_due_at_the_same_time) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  auto runs = 0;
+  Scheduler::TaskId second = 0;
+  scheduler.schedule_once(100, 0, [&] { runs++; scheduler.cancel(second); });
+  second = scheduler.schedule_once(100, 0, [&] { runs += 10; });
+  clock.advance(200);
+  CHECK(scheduler.run_due() == 1);
+  CHECK(runs == 1);
+}
+
+TEST(task_scheduled_from_a_task_runs_on_the_next_call) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  auto runs = 0;
+  scheduler.schedule_once(10, 0, [&] { scheduler.schedule_once(0, 0, [&] { runs++; }); });
+  clock.advance(10);
+  CHECK(scheduler.run_due() == 1);
+  CHECK(runs == 0);
+  auto wake = scheduler.next_wake();
+  CHECK(wake && wake->delay == 0);
+  CHECK(scheduler.run_due() == 1);
+  CHECK(runs == 1);
+}
+
+// 取りこぼした回はまとめて一回にし、位相は保つ
+TEST(periodic_keeps_its_phase) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  std::vector<Time> fired;
+  auto id = scheduler.schedule_periodic(10, 0, [&] { fired.push_back(clock.now()); });
+  clock.advance(10);
+  scheduler.run_due();
+  clock.advance(25);
+  scheduler.run_due();
+  CHECK((fired == std::vector<Time>{10, 35}));
+  auto wake = scheduler.next_wake();
+  CHECK(wake && wake->delay == 5);
+  CHECK(scheduler.is_scheduled(id));
+
+  // 自分を取り消せる
+  scheduler.cancel(id);
+  id = scheduler.schedule_periodic(100, 0, [&] { scheduler.cancel(id); });
+  clock.advance(100);
+  CHECK(scheduler.run_due() == 1);
+  CHECK(!scheduler.is_scheduled(id));
+  CHECK(!scheduler.next_wake());
+}
+
+// tolerance はどの予定の slack も破らない範囲で最大にする
+TEST(next_wake_coalesces_within_slack) {
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  scheduler.schedule_once(100, 50, [] { });
+  scheduler.schedule_once(120, 10, [] { });
+  auto wake = scheduler.next_wake();
+  CHECK(wake && wake->delay == 100 && wake->tolerance == 30);
+
+  // 後ろの予定も slack の中に入るなら、一度に起きてまとめて実行する
+  ManualClock otherClock;
+  Scheduler other{otherClock.clock()};
+  other.schedule_once(10, 1000, [] { });
+  other.schedule_once(500, 1000, [] { });
+  wake = other.next_wake();
+  CHECK(wake && wake->delay == 10 && wake->tolerance == 1000);
+  otherClock.advance(wake->delay + wake->tolerance);
+  CHECK(other.run_due() == 2);
+
+  // 取り消されたものの予定時刻や slack には縛られない
+  ManualClock thirdClock;
+  Scheduler third{thirdClock.clock()};
+  auto tight = third.schedule_once(20, 0, [] { });
+  third.schedule_once(10, 100, [] { });
+  third.cancel(tight);
+  wake = third.next_wake();
+  CHECK(wake && wake->delay == 10 && wake->tolerance == 100);
+
+  // 予定時刻を過ぎているものは今すぐ
+  clock.advance(200);
+  wake = scheduler.next_wake();
+  CHECK(wake && wake->delay == 0);
+}
+
+// 許された最も遅い時刻に起きても、どの予定も slack の中で実行される
+TEST(waking_late_by_tolerance_keeps_every_slack) {
+  std::mt19937 rng{2024};
+  std::uniform_int_distribution<Time> delays{0, 20000}, slacks{0, 3000};
+  int violations = 0;
+  for (int round=0; round<200; round++) {
+    ManualClock clock;
+    Scheduler scheduler{clock.clock()};
+    for (int i=0; i<20; i++) {
+      auto expiry = clock.now() + delays(rng), slack = slacks(rng);
+      scheduler.schedule_once(expiry - clock.now(), slack, [&, expiry, slack] {
+                                if (clock.now() < expiry || clock.now() > expiry + slack)
+                                  violations++;
+                              });
+    }
+    while (auto wake = scheduler.next_wake()) {
+      clock.advance(wake->delay + wake->tolerance);
+      scheduler.run_due();
+    }
+  }
+  CHECK(violations == 0);
+}
+
+// 登録・取り消し・時刻の進め方を混ぜて、素朴な実装と同じものを同じ順に実行する
+TEST(matches_naive_model) {
+  std::mt19937 rng{7};
+  std::uniform_int_distribution<int> op{0, 9};
+  std::uniform_int_distribution<Time> small{0, 200}, medium{0, 300000}, large{0, Time{1} << 26};
+  ManualClock clock;
+  Scheduler scheduler{clock.clock()};
+  std::map<Scheduler::TaskId, Time> model;
+  std::vector<Scheduler::TaskId> fired;
+  int mismatches = 0;
+  for (int step=0; step<20000; step++) {
+    switch (op(rng)) {
+    case 0: case 1: case 2: case 3: {
+      auto delay = step % 3 == 0 ? small(rng) : step % 3 == 1 ? medium(rng) : large(rng);
+      auto id = std::make_shared<Scheduler::TaskId>();
+      *id = scheduler.schedule_once(delay, 0, [&fired, id] { fired.push_back(*id); });
+      model.emplace(*id, clock.now() + delay);
+      break;
+    }
+    case 4:
+      if (!model.empty()) {
+        auto it = std::next(model.begin(), std::uniform_int_distribution<std::size_t>{0, model.size() - 1}(rng));
+        if (!scheduler.cancel(it->first))
+          mismatches++;
+        model.erase(it);
+      }
+      break;
+    default: {
+      clock.advance(step % 2 ? small(rng) : medium(rng));
+      std::vector<std::pair<Time, Scheduler::TaskId>> expected;
+      for (auto it = model.begin(); it != model.end(); ) {
+        if (it->second <= clock.now()) {
+          expected.emplace_back(it->second, it->first);
+          it = model.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+      fired.clear();
+      scheduler.run_due();
+      if (fired.size() != expected.size())
+        mismatches++;
+      else
+        for (std::size_t i=0; i<fired.size(); i++)
+          if (fired[i] != expected[i].second)
+            mismatches++;
+      auto wake = scheduler.next_wake();
+      if (model.empty() ? wake.has_value() : !wake || wake->delay != std::min_element(model.begin(), model.end(), [](auto const &lhs, auto const &rhs) { return lhs.second < rhs.second; })->second - clock.now())
+        mismatches++;
+      break;
+    }
+    }
+    if (scheduler.size() != model.size())
+      mismatches++;
+  }
+  CHECK(mismatches == 0);
+}
+
+int main() {
+  return Test::run_all();
+}
@@ -0,0 +1,128 @@
+#include "test_pch.h"
+#include "test_util.h"
+#include "umapita_tiling_solver.h"
+#include "tiling_cases.h"
+
+using namespace Umapita;
+using namespace TilingCases;
+using Tiling::Tile;
+using Tiling::MAX_TILES;
+
+namespace {
+
+bool is_inside(const RECT &rc, const RECT &area) {
+  return area.left <= rc.left && rc.right <= area.right && area.top <= rc.top && rc.bottom <= area.bottom;
+}
+
+bool is_overlapping(const RECT &a, const RECT &b) {
+  return std::max(a.left, b.left) < std::min(a.right, b.right) && std::max(a.top, b.top) < std::min(a.bottom, b.bottom);
+}
+
+// クライアント領域の幅は aspectX * ch / aspectY を切り捨てたもの（列に並べたときは高さの方を切り捨てる）
+bool keeps_aspect(const Tile &t, const RECT &rc) {
+  LONGLONG cw = rc.right - rc.left - t.ncW, ch = rc.bottom - rc.top - t.ncH;
+  return cw > 0 && ch > 0 &&
+    ((cw * t.aspectY <= t.aspectX * ch && t.aspectX * ch < (cw + 1) * t.aspectY) ||
+     (ch * t.aspectX <= t.aspectY * cw && t.aspectY * cw < (ch + 1) * t.aspectX));
+}
+
+// 種類と矩形の組を並べたもの。同じ種類のタイルは入れ替わってもよい
+std::vector<std::tuple<std::size_t, LONG, LONG, LONG, LONG>> placement(const std::vector<std::size_t> &kinds, const std::vector<RECT> &rects) {
+  std::vector<std::tuple<std::size_t, LONG, LONG, LONG, LONG>> ret;
+  for (std::size_t i=0; i<rects.size(); i++)
+    ret.emplace_back(kinds[i], rects[i].left, rects[i].top, rects[i].right, rects[i].bottom);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+} // namespace
+
+TEST(nothing_to_place) {
+  CHECK(Tiling::solve({}, RECT{0, 0, 1920, 1080}, -1, -1, 0, 0).empty());
+  CHECK(Tiling::solve({Tile{0, 9, 0, 0}}, RECT{0, 0, 1920, 1080}, -1, -1, 0, 0).empty());
+  // 非クライアント領域だけで領域を超える
+  CHECK(Tiling::solve({Tile{16, 9, 2000, 0}}, RECT{0, 0, 1920, 1080}, -1, -1, 0, 0).empty());
+}
+
+TEST(single_tile_fills_the_area) {
+  auto rects = Tiling::solve({Tile{16, 9, 0, 0}}, RECT{0, 0, 1920, 1080}, -1, -1, 0, 0);
+  CHECK(rects.size() == 1);
+  CHECK(AM::Win32::Op::operator == (rects[0], RECT{0, 0, 1920, 1080}));
+  // 縦長なら高さいっぱいにして、原点の側に寄せる
+  rects = Tiling::solve({Tile{9, 16, 0, 0}}, RECT{100, 0, 2020, 1080}, 1, 0, 0, 0);
+  CHECK(rects.size() == 1);
+  CHECK(rects[0].top == 0 && rects[0].bottom == 1080 && rects[0].right == 2020);
+  CHECK(keeps_aspect(Tile{9, 16, 0, 0}, rects[0]));
+}
+
+TEST(two_landscape_tiles_stack) {
+  auto rects = Tiling::solve({Tile{16, 9, 0, 0}, Tile{16, 9, 0, 0}}, RECT{0, 0, 1920, 1080}, -1, -1, 0, 0);
+  CHECK(rects.size() == 2);
+  CHECK(!is_overlapping(rects[0], rects[1]));
+  CHECK(rects[0].bottom - rects[0].top == 540 && rects[1].bottom - rects[1].top == 540);
+}
+
+TEST(places_at_most_max_tiles) {
+  std::vector<Tile> tiles(MAX_TILES + 3, Tile{16, 9, 16, 39});
+  auto rects = Tiling::solve(tiles, RECT{0, 0, 3840, 2160}, 0, 0, 0, 0);
+  CHECK(rects.size() == MAX_TILES);
+  for (std::size_t i=0; i<rects.size(); i++)
+    for (std::size_t j=0; j<i; j++)
+      CHECK(!is_overlapping(rects[i], rects[j]));
+}
+
+TEST(offset_moves_the_block_inwards) {
+  auto base = Tiling::solve({Tile{9, 16, 0, 0}}, RECT{0, 0, 1920, 1080}, 1, 1, 0, 0);
+  auto moved = Tiling::solve({Tile{9, 16, 0, 0}}, RECT{0, 0, 1920, 1080}, 1, 1, 30, 0);
+  CHECK(base.size() == 1 && moved.size() == 1);
+  CHECK(moved[0].left == base[0].left - 30 && moved[0].right == base[0].right - 30);
+}
+
+// 領域の中に重ならずに収まり、縦横比を保つ。入力の順を変えても同じ配置になる
+TEST(random_tiles_fit_without_overlap_regardless_of_order) {
+  std::mt19937 rng{31337};
+  std::uniform_int_distribution<int> align{-1, 1};
+  int outside = 0, overlaps = 0, distorted = 0, orderDependent = 0, unsolved = 0;
+  for (int round=0; round<3000; round++) {
+    auto n = 1 + round % MAX_TILES;
+    std::vector<std::size_t> kinds;
+    auto tiles = random_tiles(rng, n, kinds);
+    auto area = random_area(rng);
+    auto hAlign = align(rng), vAlign = align(rng);
+    auto rects = Tiling::solve(tiles, area, hAlign, vAlign, 0, 0);
+    if (rects.size() != n) {
+      unsolved++;
+      continue;
+    }
+    for (std::size_t i=0; i<n; i++) {
+      if (!is_inside(rects[i], area))
+        outside++;
+      if (!keeps_aspect(tiles[i], rects[i]))
+        distorted++;
+      for (std::size_t j=0; j<i; j++)
+        if (is_overlapping(rects[i], rects[j]))
+          overlaps++;
+    }
+
+    std::vector<std::size_t> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), rng);
+    std::vector<Tile> shuffledTiles;
+    std::vector<std::size_t> shuffledKinds;
+    for (auto i : perm) {
+      shuffledTiles.push_back(tiles[i]);
+      shuffledKinds.push_back(kinds[i]);
+    }
+    if (placement(kinds, rects) != placement(shuffledKinds, Tiling::solve(shuffledTiles, area, hAlign, vAlign, 0, 0)))
+      orderDependent++;
+  }
+  CHECK(unsolved == 0);
+  CHECK(outside == 0);
+  CHECK(overlaps == 0);
+  CHECK(distorted == 0);
+  CHECK(orderDependent == 0);
+}
+
+int main() {
+  return Test::run_all();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// 最低限のテスト用マクロ
+//
+//   TEST(name) { CHECK(1 + 1 == 2); }
+//   int main() { return Test::run_all(); }
+//
+namespace Test {
+
+struct Case {
+  const char *name;
+  void (*fn)();
+};
+
+inline std::vector<Case> &cases() {
+  static std::vector<Case> s_cases;
+  return s_cases;
+}
+inline int &failures() {
+  static int s_failures = 0;
+  return s_failures;
+}
+
+struct Registrar {
+  Registrar(const char *name, void (*fn)()) { cases().push_back(Case{name, fn}); }
+};
+
+inline void fail(const char *file, int line, const char *expr) {
+  std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+  failures()++;
+}
+
+inline int run_all() {
+  for (auto const &c : cases()) {
+    auto before = failures();
+    c.fn();
+    std::printf("%s %s\n", failures() == before ? "ok  " : "FAIL", c.name);
+  }
+  std::printf("%d failure(s)\n", failures());
+  return failures() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// ベンチマークの結果を 1 行で出す
+inline void report(const char *name, std::vector<double> samples, const char *unit) {
+  if (samples.empty())
+    return;
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (auto v : samples)
+    sum += v;
+  auto pick = [&samples](double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))]; };
+  std::printf("%-40s n=%-8u mean=%10.3f p50=%10.3f p99=%10.3f max=%10.3f %s\n",
+              name, static_cast<unsigned>(samples.size()), sum / samples.size(), pick(0.5), pick(0.99), samples.back(), unit);
+}
+
+} // namespace Test
+
+#define TEST(name)                                              \
+  static void name();                                           \
+  static Test::Registrar name##_registrar{#name, name};         \
+  static void name()
+
+#define CHECK(expr)                                             \
+  do {                                                          \
+    if (!(expr))                                                \
+      Test::fail(__FILE__, __LINE__, #expr);                    \
+  } while (0)
@@ -0,0 +1,40 @@
+#pragma once
+
+//
+// Tiling::solve() のテスト・ベンチマーク用のタイルと領域
+//
+namespace TilingCases {
+
+// 縦横比と非クライアント領域の組。同じ種類のタイルは区別がつかない
+struct Kind {
+  LONG aspectX, aspectY, ncW, ncH;
+};
+
+const Kind KINDS[] = {
+  {16, 9, 16, 39}, {9, 16, 16, 39}, {16, 9, 0, 0}, {4, 3, 16, 39}, {3, 4, 2, 2}, {1, 1, 16, 39}, {21, 9, 16, 39},
+};
+
+inline Umapita::Tiling::Tile make_tile(const Kind &k) {
+  return Umapita::Tiling::Tile{k.aspectX, k.aspectY, k.ncW, k.ncH};
+}
+
+// kinds[i] は tiles[i] の種類の番号
+inline std::vector<Umapita::Tiling::Tile> random_tiles(std::mt19937 &rng, std::size_t n, std::vector<std::size_t> &kinds) {
+  std::uniform_int_distribution<std::size_t> pick{0, std::size(KINDS) - 1};
+  std::vector<Umapita::Tiling::Tile> tiles;
+  kinds.clear();
+  for (std::size_t i=0; i<n; i++) {
+    kinds.push_back(pick(rng));
+    tiles.push_back(make_tile(KINDS[kinds.back()]));
+  }
+  return tiles;
+}
+
+// 負の座標も含めた、ありそうな大きさのモニタの作業領域
+inline RECT random_area(std::mt19937 &rng) {
+  std::uniform_int_distribution<LONG> pos{-4000, 4000}, w{800, 3840}, h{600, 2160};
+  auto left = pos(rng), top = pos(rng);
+  return RECT{left, top, left + w(rng), top + h(rng)};
+}
+
+} // namespace TilingCases
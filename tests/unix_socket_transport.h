@@ -0,0 +1,172 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//
+// 名前付きパイプの代わりに Unix ドメインソケットを使う Transport
+//
+// Server を Windows なしで動かすためのもの。socketpair() で繋いだ組を用意しておき、
+// サーバ側を accept() で一つずつ渡す（ファイルシステムにソケットを作らない）。
+//
+namespace Umapita::Ipc {
+
+class UnixSocketConnection : public Connection {
+  int m_fd;
+  std::function<void (int)> m_onClose;
+
+public:
+  UnixSocketConnection(int fd, std::function<void (int)> onClose) : m_fd{fd}, m_onClose{std::move(onClose)} { }
+  ~UnixSocketConnection() override {
+    // 名前付きパイプと同じく、クライアントが閉じるまで IO_TIMEOUT だけ読み捨てる。
+    // Transport::shutdown() されると読めなくなる (SHUT_RDWR) のですぐ抜ける
+    ::shutdown(m_fd, SHUT_WR);
+    auto deadline = std::chrono::steady_clock::now() + IO_TIMEOUT;
+    for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now()) {
+      pollfd pfd{m_fd, POLLIN, 0};
+      auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+      if (::poll(&pfd, 1, static_cast<int>(timeout)) <= 0)
+        break;
+      std::uint8_t scratch[64];
+      if (::recv(m_fd, scratch, sizeof (scratch), 0) <= 0)
+        break;
+    }
+    if (m_onClose)
+      m_onClose(m_fd);
+    ::close(m_fd);
+  }
+  bool read(void *buf, std::size_t len) override {
+    auto p = static_cast<std::uint8_t *>(buf);
+    while (len) {
+      auto n = ::recv(m_fd, p, len, 0);
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+  bool write(const void *buf, std::size_t len) override {
+    auto p = static_cast<const std::uint8_t *>(buf);
+    while (len) {
+      auto n = ::send(m_fd, p, len, MSG_NOSIGNAL);
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+};
+
+class UnixSocketTransport : public Transport {
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<int> m_pending;   // まだ accept() していないサーバ側
+  std::vector<int> m_active;   // accept() 済みで生きているサーバ側
+  bool m_isShutdown = false;
+  bool m_failNext = false;
+
+public:
+  ~UnixSocketTransport() override {
+    for (auto fd : m_pending)
+      ::close(fd);
+  }
+
+  // クライアント側の fd を返す。閉じるのは呼び出し側
+  int connect() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+      return -1;
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_pending.push_back(fds[0]);
+    }
+    m_cond.notify_all();
+    return fds[1];
+  }
+  // 次の accept() を一回だけ失敗させる（再試行の確認用）
+  void fail_next_accept() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_failNext = true;
+  }
+
+  std::unique_ptr<Connection> accept() override {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_failNext) {
+      m_failNext = false;
+      return nullptr;
+    }
+    m_cond.wait(lock, [this] { return m_isShutdown || !m_pending.empty(); });
+    if (m_isShutdown)
+      return nullptr;
+    auto fd = m_pending.front();
+    m_pending.pop_front();
+    m_active.push_back(fd);
+    return std::make_unique<UnixSocketConnection>(fd, [this](int fd) {
+                                                        std::lock_guard<std::mutex> lock{m_mutex};
+                                                        m_active.erase(std::remove(m_active.begin(), m_active.end(), fd), m_active.end());
+                                                      });
+  }
+  void shutdown() override {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_isShutdown = true;
+    // 読み書きの途中のものを起こす
+    for (auto fd : m_active)
+      ::shutdown(fd, SHUT_RDWR);
+    m_cond.notify_all();
+  }
+};
+
+//
+// クライアント
+//
+class UnixSocketClient {
+  int m_fd;
+
+  bool read_all(void *buf, std::size_t len) {
+    auto p = static_cast<std::uint8_t *>(buf);
+    while (len) {
+      auto n = ::recv(m_fd, p, len, 0);
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+
+public:
+  explicit UnixSocketClient(UnixSocketTransport &transport) : m_fd{transport.connect()} { }
+  ~UnixSocketClient() { if (m_fd >= 0) ::close(m_fd); }
+  UnixSocketClient(const UnixSocketClient &) = delete;
+  UnixSocketClient &operator = (const UnixSocketClient &) = delete;
+
+  bool send_raw(const Buffer &buf) {
+    return ::send(m_fd, buf.data(), buf.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(buf.size());
+  }
+  // レスポンスを一つ読む。切断されていたら false
+  bool receive(Header &header, Buffer &payload) {
+    std::uint8_t raw[HEADER_SIZE];
+    if (!read_all(raw, sizeof (raw)) || !decode_header(raw, header))
+      return false;
+    payload.resize(header.length);
+    return !header.length || read_all(payload.data(), payload.size());
+  }
+  bool request(Opcode opcode, const Buffer &body, StatusCode &status, Buffer &payload) {
+    Header header;
+    if (!send_raw(encode_message(static_cast<std::uint16_t>(opcode), body)) || !receive(header, payload))
+      return false;
+    status = static_cast<StatusCode>(header.code);
+    return true;
+  }
+  // サーバが切断したか（EOF が読めるか）
+  bool is_closed_by_peer() {
+    std::uint8_t c;
+    return ::recv(m_fd, &c, 1, 0) == 0;
+  }
+};
+
+} // namespace Umapita::Ipc
@@ -9,10 +9,23 @@
 #include "umapita_misc.h"
 #include "umapita_setting.h"
 #include "umapita_registry.h"
+#include "umapita_monitor_index.h"
 #include "umapita_monitors.h"
 #include "umapita_custom_group_box.h"
 #include "umapita_save_dialog_box.h"
 #include "umapita_target_status.h"
+#include "umapita_hot_key.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
+#include "umapita_scheduler.h"
+#include "umapita_tracker.h"
+#include "umapita_startup_probe.h"
+#include "umapita_ipc_protocol.h"
+#include "umapita_ipc_transport.h"
+#include "umapita_ipc_server.h"
+#include "umapita_perf_shm.h"
+#include "umapita_win_event_hook.h"
+#include "umapita_headless.h"
 #include "umapita_res.h"
 
 namespace Win32 = AM::Win32;
@@ -33,65 +46,61 @@ constexpr static CheckButtonMap<bool> make_bool_check_button_map(int id) {
 template <typename Enum, std::size_t Num>
 using RadioButtonMap = std::array<std::pair<Enum, int>, Num>;
 
+//
+// ポップアップメニュー
+//
+static void show_popup_menu(Window owner, const UmapitaSetting::GlobalCommon &common, TPMPARAMS *pTpmp = nullptr) {
+  POINT point;
+
+  GetCursorPos(&point);
+  owner.set_foreground();
+
+  auto menu = Win32::load_menu(owner.get_instance(), MAKEINTRESOURCE(IDM_POPUP));
+  auto submenu = Win32::get_sub_menu(menu, 0);
+
+  // IDC_LOW_MEMORY_MODE, IDC_TILING_MODE のチェック状態を変更する
+  auto set_check = [&submenu](UINT id, bool isChecked) {
+                     auto mii = Win32::make_sized_pod<MENUITEMINFO>();
+                     mii.fMask = MIIM_STATE;
+                     mii.fState = isChecked ? MFS_CHECKED : 0;
+                     SetMenuItemInfo(submenu.hMenu, id, false, &mii);
+                   };
+  set_check(IDC_LOW_MEMORY_MODE, common.isLowMemoryMode);
+  set_check(IDC_TILING_MODE, common.isTilingMode);
+  set_check(IDC_ADOPT_DROPPED_POSITION, common.isAdoptDroppedPosition);
+
+  TrackPopupMenuEx(submenu.hMenu, TPM_LEFTALIGN | TPM_LEFTBUTTON, point.x, point.y, owner.get(), pTpmp);
+}
+
 //
 // main dialog
 //
 class MainDialogBox : public Win32::Dialog::Template<MainDialogBox> {
   friend class Win32::Dialog::Template<MainDialogBox>;
 private:
-  static UINT s_msgTaskbarCreated;
   static Win32::Icon s_appIcon, s_appIconSm;
+  static bool s_isInstanceInitialized;
   //
+  Window m_host;
+  Umapita::Tracker &m_tracker;
   UmapitaCustomGroupBox m_verticalGroupBox, m_horizontalGroupBox;
-  UmapitaMonitors m_monitors;
-  Umapita::TargetStatus m_lastTargetStatus;
   bool m_isDialogChanged = false;
-  UmapitaSetting::Global m_currentGlobalSetting{UmapitaSetting::DEFAULT_GLOBAL.clone<Win32::tstring>()};
+  UmapitaSetting::Global &m_currentGlobalSetting;
   int m_enterCount = 0;
-  bool m_isHotKeyEnabled = false;
 
-  //
-  // タスクトレイアイコン
-  //
-  BOOL add_tasktray_icon(HICON hIcon) {
-    auto nid = Win32::make_sized_pod<NOTIFYICONDATA>();
-    nid.hWnd = get_window().get();
-    nid.uID = TASKTRAY_ID;
-    nid.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
-    nid.uCallbackMessage = WM_TASKTRAY;
-    nid.hIcon = hIcon;
-    LoadString(get_window().get_instance(), IDS_TASKTRAY_TIP, nid.szTip, std::size(nid.szTip));
-    return Shell_NotifyIcon(NIM_ADD, &nid);
-  }
-  void delete_tasktray_icon() {
-    auto nid = Win32::make_sized_pod<NOTIFYICONDATA>();
-    nid.hWnd = get_window().get();
-    nid.uID = TASKTRAY_ID;
-    Shell_NotifyIcon(NIM_DELETE, &nid);
-  }
-
-
-  //
-  // ポップアップメニュー
-  //
-  void show_popup_menu(TPMPARAMS *pTpmp = nullptr) {
-    POINT point;
-
-    GetCursorPos(&point);
-    get_window().set_foreground();
-
-    auto menu = Win32::load_menu(get_window().get_instance(), MAKEINTRESOURCE(IDM_POPUP));
-    auto submenu = Win32::get_sub_menu(menu, 0);
-    TrackPopupMenuEx(submenu.hMenu, TPM_LEFTALIGN | TPM_LEFTBUTTON, point.x, point.y, get_window().get(), pTpmp);
+  // 設定が変更されたので、次の tick でコントロールの状態を更新し、ターゲットを再配置する
+  void set_dialog_changed() {
+    m_isDialogChanged = true;
+    m_tracker.invalidate();
   }
 
-
   //
   // ダイアログボックス上のコントロールと設定のマッピング
   //
   struct SelectMonitorMap {
     int id;
     int base;
+    int follow;
   };
 
   struct PerOrientationSettingID {
@@ -133,7 +142,7 @@ private:
     // offsetY
     IDC_V_OFFSET_Y,
     // selectMonitor
-    {IDC_V_SELECT_MONITORS, IDM_V_MONITOR_BASE},
+    {IDC_V_SELECT_MONITORS, IDM_V_MONITOR_BASE, IDM_V_MONITOR_FOLLOW},
   };
   constexpr static PerOrientationSettingID HORIZONTAL_SETTING_ID = {
     // monitorNumber
@@ -163,7 +172,7 @@ private:
     // offsetY
     IDC_H_OFFSET_Y,
     // selectMonitor
-    {IDC_H_SELECT_MONITORS, IDM_H_MONITOR_BASE},
+    {IDC_H_SELECT_MONITORS, IDM_H_MONITOR_BASE, IDM_H_MONITOR_FOLLOW},
   };
 
 
@@ -186,6 +195,19 @@ private:
     get_window().get_item(id).set_text(Win32::asprintf(TEXT("%d"), num));
   }
 
+  // メニューから物理モニタを選んだときは、番号と一緒に抜き差しで変わらない名前も覚えておく
+  void set_monitor_name(Win32::tstring &stor, int num) {
+    Win32::tstring name;
+    if (auto m = m_tracker.monitors().get_monitor_by_number(num); m && num > 0)
+      name = m->id.empty() ? m->name : m->id;
+    if (name != stor) {
+      Log::debug(TEXT("monitor name changed: \"%ls\" -> \"%ls\""), stor.c_str(), name.c_str());
+      stor = name;
+      m_currentGlobalSetting.common.isCurrentProfileChanged = true;
+      set_dialog_changed();
+    }
+  }
+
   auto make_long_integer_box_handler(LONG &stor) {
     return [this, &stor](Window, Window control, int id, int notify) {
              switch (notify) {
@@ -196,7 +218,7 @@ private:
                  Log::debug(TEXT("text box %X changed: %d -> %d"), id, stor, val);
                  stor = val;
                  m_currentGlobalSetting.common.isCurrentProfileChanged = true;
-                 m_isDialogChanged = true;
+                 set_dialog_changed();
                }
                return TRUE;
              }
@@ -216,7 +238,7 @@ private:
                  stor = val;
                  if (!isGlobal)
                    m_currentGlobalSetting.common.isCurrentProfileChanged = true;
-                 m_isDialogChanged = true;
+                 set_dialog_changed();
                }
                return TRUE;
              }
@@ -235,7 +257,7 @@ private:
                    Log::debug(TEXT("radio button %X changed: %d -> %d"), cid, static_cast<int>(stor), static_cast<int>(tag));
                    stor = tag;
                    m_currentGlobalSetting.common.isCurrentProfileChanged = true;
-                   m_isDialogChanged = true;
+                   set_dialog_changed();
                    return TRUE;
                  }
                }
@@ -292,8 +314,16 @@ private:
       register_command(id, h);
   }
 
-  void init_per_orientation_settings(const PerOrientationSettingID &ids, UmapitaSetting::PerOrientation &setting) {
-    register_command(ids.monitorNumber, make_long_integer_box_handler(setting.monitorNumber));
+  void init_per_orientation_settings(const PerOrientationSettingID &ids, UmapitaSetting::PerOrientation &setting, Win32::tstring &monitorName) {
+    register_command(ids.monitorNumber,
+                     [this, &setting, &monitorName, h = make_long_integer_box_handler(setting.monitorNumber)](Window dialog, Window control, int id, int notify) {
+                       auto old = setting.monitorNumber;
+                       auto ret = h(dialog, control, id, notify);
+                       // 番号を直接書き換えたら名前による指定はやめる
+                       if (setting.monitorNumber != old)
+                         monitorName.clear();
+                       return ret;
+                     });
     register_command(ids.isConsiderTaskbar, make_check_button_handler(ids.isConsiderTaskbar, setting.isConsiderTaskbar));
     register_command(ids.windowArea, make_radio_button_map(ids.windowArea, setting.windowArea));
     register_command(ids.size, make_long_integer_box_handler(setting.size));
@@ -303,18 +333,20 @@ private:
     register_command(ids.offsetY, make_long_integer_box_handler(setting.offsetY));
     register_command(ids.selectMonitor.id,
                      make_menu_button_handler(ids.selectMonitor.id,
-                                              [this, ids, &setting]() {
+                                              [this, ids, &setting, &monitorName]() {
                                                 Log::debug(TEXT("selectMonitor received"));
                                                 auto menu = Win32::create_popup_menu();
                                                 int id = ids.selectMonitor.base;
-                                                m_monitors.enum_monitors(
-                                                  [&setting, &id, &menu](auto index, auto const &m) {
-                                                    auto const &[name, whole, work] = m;
-                                                    auto const &rc = setting.isConsiderTaskbar ? work : whole;
-                                                    AppendMenu(menu.get(), MF_STRING, id++,
+                                                m_tracker.monitors().enum_monitors(
+                                                  [&setting, &monitorName, &id, &menu](auto index, auto const &m) {
+                                                    auto const &rc = setting.isConsiderTaskbar ? m.work : m.whole;
+                                                    auto isNamed = index > 0 && !monitorName.empty() && (monitorName == m.id || monitorName == m.name);
+                                                    AppendMenu(menu.get(), MF_STRING | (isNamed ? MF_CHECKED : MF_UNCHECKED), id++,
                                                                Win32::asprintf(TEXT("%2d: (%6ld,%6ld)-(%6ld,%6ld) %ls"),
-                                                                               index, rc.left, rc.top, rc.right, rc.bottom, name.c_str()).c_str());
+                                                                               index, rc.left, rc.top, rc.right, rc.bottom, m.name.c_str()).c_str());
                                                   });
+                                                AppendMenu(menu.get(), MF_STRING, ids.selectMonitor.follow,
+                                                           Win32::asprintf(TEXT("%2d: <follow target window>"), MONITOR_NUMBER_FOLLOW).c_str());
                                                 return std::make_pair(0 /*dummy*/, std::move(menu));
                                               }));
   }
@@ -354,10 +386,7 @@ private:
       return;
     }
     auto str = Win32::get_sz(len, [item, n](LPTSTR buf, std::size_t len) { ComboBox_GetLBText(item.get(), n, buf); });
-    item.set_text(str);
-    get_window().post(WM_CHANGE_PROFILE, 0, item.to<LPARAM>());
-    // テキストがセレクトされるのがうっとうしいのでクリアする
-    item.post(CB_SETEDITSEL, 0, MAKELPARAM(-1, -1));
+    request_profile(str);
   }
 
   void update_per_orientation_lock_status(const PerOrientationSettingID &ids, bool isLocked) {
@@ -456,8 +485,8 @@ private:
       Edit_SetReadOnly(cbi.hwndItem, true);
     }
 
-    init_per_orientation_settings(VERTICAL_SETTING_ID, setting.currentProfile.vertical);
-    init_per_orientation_settings(HORIZONTAL_SETTING_ID, setting.currentProfile.horizontal);
+    init_per_orientation_settings(VERTICAL_SETTING_ID, setting.currentProfile.vertical, setting.currentProfile.vMonitorName);
+    init_per_orientation_settings(HORIZONTAL_SETTING_ID, setting.currentProfile.horizontal, setting.currentProfile.hMonitorName);
 
     register_command(
       IDC_SELECT_PROFILE,
@@ -514,7 +543,7 @@ private:
         Log::debug(TEXT("IDC_LOCK received"));
         m_currentGlobalSetting.currentProfile.isLocked = !m_currentGlobalSetting.currentProfile.isLocked;
         m_currentGlobalSetting.common.isCurrentProfileChanged = true;
-        m_isDialogChanged = true;
+        set_dialog_changed();
         return TRUE;
       });
     register_command(
@@ -566,7 +595,7 @@ private:
         }
         UmapitaRegistry::delete_profile(s.common.currentProfileName);
         s.common.currentProfileName = TEXT("");
-        m_isDialogChanged = true;
+        set_dialog_changed();
         update_main_controlls();
         return TRUE;
       });
@@ -597,12 +626,12 @@ private:
               return TRUE;
             }
           }
-          s.currentProfile = UmapitaSetting::DEFAULT_PER_PROFILE;
+          s.currentProfile = UmapitaSetting::DEFAULT_PER_PROFILE.clone<Win32::tstring>();
           s.common.isCurrentProfileChanged = false;
           break;
         }
         s.common.currentProfileName = TEXT("");
-        m_isDialogChanged = true;
+        set_dialog_changed();
         update_main_controlls();
         return TRUE;
       });
@@ -616,7 +645,7 @@ private:
     update_main_controlls();
   }
 
-  void update_target_status_text(const Umapita::TargetStatus &ts) {
+  void update_target_status_text(const Umapita::TargetStatus &ts, Umapita::ConvergenceGuard::State convergence) {
     bool isHorizontal = false, isVertical = false;
     auto text = Win32::tstring{TEXT("<target not found>")};
     if (ts.window) {
@@ -631,6 +660,17 @@ private:
                              ts.windowRect.left, ts.windowRect.top, wW, wH,
                              ts.clientRect.left, ts.clientRect.top, cW, cH,
                              Win32::load_string(get_window().get_instance(), isHorizontal ? IDS_HORIZONTAL:IDS_VERTICAL).c_str());
+      // 理想の位置に届かない・取り合いになっているときはそれとわかるようにする
+      switch (convergence) {
+      case Umapita::ConvergenceGuard::Settled:
+        text += Win32::load_string(get_window().get_instance(), IDS_CONVERGENCE_SETTLED);
+        break;
+      case Umapita::ConvergenceGuard::BackingOff:
+        text += Win32::load_string(get_window().get_instance(), IDS_CONVERGENCE_BACKING_OFF);
+        break;
+      default:
+        break;
+      }
     }
     get_window().get_item(IDC_TARGET_STATUS).set_text(text);
     m_verticalGroupBox.set_selected(isVertical);
@@ -659,23 +699,39 @@ private:
     // disable close button / menu
     EnableMenuItem(hMenu, SC_CLOSE, MF_BYCOMMAND | MF_DISABLED | MF_GRAYED);
     //
-    m_currentGlobalSetting = UmapitaRegistry::load_global_setting();
     init_main_controlls();
     register_command(
       IDC_HIDE,
-      [](Window dialog) {
+      [this](Window dialog) {
         Log::debug(TEXT("IDC_HIDE received"));
         dialog.show(SW_HIDE);
+        // 省メモリモードならここでダイアログが破棄される
+        m_host.post(WM_COMMAND, IDC_HIDE, 0);
         return TRUE;
       });
     register_command(
       IDC_QUIT,
       [this]() {
         Log::debug(TEXT("IDC_QUIT received"));
-        UmapitaRegistry::save_global_setting(m_currentGlobalSetting);
-        delete_tasktray_icon();
-        get_window().kill_timer(TIMER_ID);
-        get_window().destroy();
+        m_host.post(WM_COMMAND, IDC_QUIT, 0);
+        return TRUE;
+      });
+    register_command(
+      IDC_LOW_MEMORY_MODE,
+      [this]() {
+        m_host.post(WM_COMMAND, IDC_LOW_MEMORY_MODE, 0);
+        return TRUE;
+      });
+    register_command(
+      IDC_TILING_MODE,
+      [this]() {
+        m_host.post(WM_COMMAND, IDC_TILING_MODE, 0);
+        return TRUE;
+      });
+    register_command(
+      IDC_ADOPT_DROPPED_POSITION,
+      [this]() {
+        m_host.post(WM_COMMAND, IDC_ADOPT_DROPPED_POSITION, 0);
         return TRUE;
       });
     register_command(
@@ -691,99 +747,35 @@ private:
         IDM_V_MONITOR_BASE+i,
         [this](Window, Window, int id, int) {
           set_monitor_number(IDC_V_MONITOR_NUMBER, id - IDM_V_MONITOR_BASE - 1);
+          set_monitor_name(m_currentGlobalSetting.currentProfile.vMonitorName, id - IDM_V_MONITOR_BASE - 1);
           return TRUE;
         });
       register_command(
         IDM_H_MONITOR_BASE+i,
         [this](Window, Window, int id, int) {
           set_monitor_number(IDC_H_MONITOR_NUMBER, id - IDM_H_MONITOR_BASE - 1);
+          set_monitor_name(m_currentGlobalSetting.currentProfile.hMonitorName, id - IDM_H_MONITOR_BASE - 1);
           return TRUE;
         });
     }
-    get_window().post(s_msgTaskbarCreated, 0, 0);
-
-    get_window().post(WM_DISPLAYCHANGE, 0, 0);
-
-    m_isDialogChanged = true;
-    get_window().post(WM_TIMER, TIMER_ID, 0);
-
-    return TRUE;
-  }
-
-  MessageHandlers::MaybeResult h_tasktray(Window, UINT, WPARAM, LPARAM lParam) {
-    switch (lParam) {
-    case WM_RBUTTONDOWN: {
-      TPMPARAMS tpmp = Win32::make_sized_pod<TPMPARAMS>(), *pTpmp = nullptr;
-      if (auto shell = Window::find(TEXT("Shell_TrayWnd"), nullptr); shell) {
-        auto rect = shell.get_window_rect();
-        tpmp.rcExclude = rect;
-        pTpmp = &tpmp;
-      }
-      show_popup_menu(pTpmp);
-      return TRUE;
-    }
+    register_command(
+      IDM_V_MONITOR_FOLLOW,
+      [this](Window, Window, int, int) {
+        set_monitor_number(IDC_V_MONITOR_NUMBER, MONITOR_NUMBER_FOLLOW);
+        return TRUE;
+      });
+    register_command(
+      IDM_H_MONITOR_FOLLOW,
+      [this](Window, Window, int, int) {
+        set_monitor_number(IDC_H_MONITOR_NUMBER, MONITOR_NUMBER_FOLLOW);
+        return TRUE;
+      });
 
-    case WM_LBUTTONDOWN:
-      // show / hide main dialog
-      if (get_window().is_visible())
-        get_window().post(WM_SYSCOMMAND, SC_MINIMIZE, 0);
-      else
-        get_window().post(WM_COMMAND, IDC_SHOW, 0);
-      return TRUE;
-    }
-    return FALSE;
-  }
+    set_dialog_changed();
 
-  MessageHandlers::MaybeResult h_timer() {
-    if (m_isDialogChanged) {
-      update_lock_status();
-      update_profile_text();
-      m_lastTargetStatus = Umapita::TargetStatus{};
-      m_isDialogChanged = false;
-    }
-    if (auto ts = Umapita::TargetStatus::get(TARGET_WINDOW_CLASS, TARGET_WINDOW_NAME); ts != m_lastTargetStatus) {
-      m_lastTargetStatus = ts;
-      if (m_currentGlobalSetting.common.isEnabled)
-        m_lastTargetStatus.adjust(m_monitors, m_currentGlobalSetting.currentProfile);
-      update_target_status_text(m_lastTargetStatus);
-      // ホットキーの調整
-      if (m_currentGlobalSetting.common.isEnabled && m_lastTargetStatus.isFocusOn) {
-        // 調整が有効でフォーカスがターゲットにあればホットキーを有効にする
-        register_hot_keys();
-      } else {
-        // そうでなければ無効にする
-        unregister_hot_keys();
-      }
-    }
-    get_window().set_timer(TIMER_ID, TIMER_PERIOD, nullptr);
     return TRUE;
   }
 
-  void register_hot_keys() {
-    if (!m_isHotKeyEnabled) {
-      Log::info(TEXT("enable hot keys"));
-      m_isHotKeyEnabled = true;
-      for (int i=0; i<10; i++) {
-        int id = i+HOT_KEY_ID_BASE;
-        UINT keycode = 0x30+i;
-        if (!RegisterHotKey(get_window().get(), id, MOD_ALT, keycode)) {
-          Log::warning(TEXT("cannot set Alt+%hc as hot key"), id);
-        }
-      }
-    }
-  }
-
-  void unregister_hot_keys() {
-    if (m_isHotKeyEnabled) {
-      Log::info(TEXT("disable hot keys"));
-      m_isHotKeyEnabled = false;
-      for (int i=0; i<10; i++) {
-        int id = i+HOT_KEY_ID_BASE;
-        UnregisterHotKey(get_window().get(), id);
-      }
-    }
-  }
-
   MessageHandlers::MaybeResult h_setfont(Window, UINT, WPARAM wParam, LPARAM) {
     // ダイアログのフォントを明示的に設定していると呼ばれる
     auto hFont = reinterpret_cast<HFONT>(wParam);
@@ -799,44 +791,20 @@ private:
     switch (confirm_save()) {
     case IDOK: {
       Log::debug(TEXT("selected: %ls"), n.c_str());
-      m_currentGlobalSetting.common.currentProfileName = n;
-      m_currentGlobalSetting.currentProfile = UmapitaRegistry::load_setting(n);
-      m_currentGlobalSetting.common.isCurrentProfileChanged = false;
+      m_tracker.load_profile(n);
       break;
     }
     case IDCANCEL:
       Log::debug(TEXT("canceled"));
       break;
     }
-    m_isDialogChanged = true;
+    set_dialog_changed();
     update_main_controlls();
     // テキストがセレクトされるのがうっとうしいのでクリアする
     control.post(CB_SETEDITSEL, 0, MAKELPARAM(-1, -1));
     return TRUE;
   }
 
-  MessageHandlers::MaybeResult h_hotkey(Window dialog, UINT, WPARAM wParam, LPARAM lParam) {
-    Log::debug(TEXT("WM_HOTKEY: wParam=%X, lParam=%X, enterCount=%d"),
-               static_cast<unsigned>(wParam), static_cast<unsigned>(lParam), m_enterCount);
-    auto n = static_cast<WORD>((wParam - HOT_KEY_ID_BASE));
-    if (n<10) {
-      n &= 0x0F;
-      n = (n ? n : 10) - 1;
-      if (m_enterCount == 1) {
-        // enterCount が 1 よりも大きい場合、モーダルダイアログが開いている可能性があるので送らない。
-        // モーダルダイアログが開いているときに送ると、別のモーダルダイアログが開いたり、いろいろ嫌なことが起こる。
-        dialog.post(WM_COMMAND, MAKEWPARAM(n + IDC_SEL_BEGIN, 0), 0);
-      }
-    }
-    return TRUE;
-  }
-
-  void reset_monitors() {
-    Log::debug(TEXT("reset monitors"));
-    m_monitors = UmapitaMonitors{};
-    m_isDialogChanged = true;
-  }
-
   static void register_main_dialog_class(HINSTANCE hInst) {
     auto wc = Win32::make_sized_pod<WNDCLASSEX>();
     wc.style = 0;
@@ -854,7 +822,7 @@ private:
   }
 
   static void init_instance(HINSTANCE hInst) {
-    if (!s_msgTaskbarCreated) {
+    if (!s_isInstanceInitialized) {
       auto cx = GetSystemMetrics(SM_CXICON);
       auto cy = GetSystemMetrics(SM_CYICON);
 
@@ -863,7 +831,7 @@ private:
 
       register_main_dialog_class(hInst);
 
-      s_msgTaskbarCreated = RegisterWindowMessage(TEXT("TaskbarCreated"));
+      s_isInstanceInitialized = true;
     }
   }
 
@@ -872,7 +840,8 @@ private:
   }
 
 public:
-  MainDialogBox(HINSTANCE hInst, Window owner = Window{}) {
+  MainDialogBox(HINSTANCE hInst, Window host, Umapita::Tracker &tracker, Window owner = Window{})
+    : m_host{host}, m_tracker{tracker}, m_currentGlobalSetting{tracker.setting()} {
     init_instance(hInst);
     register_message(WM_INITDIALOG, Win32::Handler::binder(*this, h_initdialog));
     register_message(
@@ -880,48 +849,610 @@ public:
       [this] {
         m_verticalGroupBox.restore_window_proc();
         m_horizontalGroupBox.restore_window_proc();
-        PostQuitMessage(0);
         return TRUE;
       });
-    register_message(s_msgTaskbarCreated, [this] { add_tasktray_icon(s_appIconSm.get()); return TRUE; });
-    register_message(WM_TASKTRAY, Win32::Handler::binder(*this, h_tasktray));
     register_system_command(SC_MINIMIZE, [](Window dialog) { dialog.post(WM_COMMAND, IDC_HIDE, 0); return TRUE; });
     register_system_command(IDC_QUIT, [](Window dialog) { dialog.post(WM_COMMAND, IDC_QUIT, 0); return TRUE; });
-    register_message(WM_RBUTTONDOWN, [this] { show_popup_menu(); return TRUE; });
-    register_message(WM_TIMER, Win32::Handler::binder(*this, h_timer));
-    register_message(WM_DISPLAYCHANGE, [this] { reset_monitors(); return TRUE; });
-    register_message(WM_SETTINGCHANGE, [this] { reset_monitors(); return TRUE; });
+    register_message(WM_RBUTTONDOWN, [this] { show_popup_menu(get_window(), m_currentGlobalSetting.common); return TRUE; });
     register_message(WM_SETFONT, Win32::Handler::binder(*this, h_setfont));
     register_message(WM_CHANGE_PROFILE, Win32::Handler::binder(*this, h_change_profile));
-    register_message(WM_HOTKEY, Win32::Handler::binder(*this, h_hotkey));
     create_modeless(owner);
   }
 
+  using Win32::Dialog::Template<MainDialogBox>::get_window;
+
+  // プロファイルの切り替えを要求する（未保存の変更があれば確認される）
+  void request_profile(const Win32::tstring &name) {
+    auto item = get_window().get_item(IDC_SELECT_PROFILE);
+    item.set_text(name);
+    get_window().post(WM_CHANGE_PROFILE, 0, item.to<LPARAM>());
+    // テキストがセレクトされるのがうっとうしいのでクリアする
+    item.post(CB_SETEDITSEL, 0, MAKELPARAM(-1, -1));
+  }
+
+  // ダイアログの外で設定が変更されたときに呼ぶ
+  void reload_controls() {
+    set_dialog_changed();
+    update_main_controlls();
+  }
+
+  // モーダルダイアログなどを処理中でなければ true
+  bool is_idle() const {
+    return m_enterCount == 0;
+  }
+
+  // Tracker::tick の後に呼ばれる。changes は前回からのターゲットの変化の種類
+  void update(Umapita::TargetChangeMask changes) {
+    if (m_isDialogChanged) {
+      update_lock_status();
+      update_profile_text();
+      m_isDialogChanged = false;
+      changes = Umapita::TargetChange::All;
+    }
+    // 表示しているのは位置と大きさだけなので、フォーカスの出入りでは書き直さない
+    if (changes & (Umapita::TargetChange::Identity | Umapita::TargetChange::Geometry))
+      update_target_status_text(m_tracker.last_target_status(), m_tracker.convergence_state());
+  }
+};
+
+Win32::Icon MainDialogBox::s_appIcon = nullptr, MainDialogBox::s_appIconSm = nullptr;
+bool MainDialogBox::s_isInstanceInitialized = false;
+
+
+//
+// 常駐ウィンドウ
+//
+// タスクトレイアイコン・タイマ・ホットキーを受け持ち、Tracker を保持する。
+// TaskbarCreated や WM_DISPLAYCHANGE などのブロードキャストを受け取る必要があるので、
+// メッセージ専用ウィンドウではなく非表示のトップレベルウィンドウにしている。
+// メインダイアログは必要になったときに作り、省メモリモードでは非表示にしたときに破棄する。
+//
+class HostWindow : public Win32::CustomControl::Template<HostWindow> {
+  using MaybeResult = Win32::CustomControl::MessageHandlers::MaybeResult;
+  static UINT s_msgTaskbarCreated;
+  // win_event_proc の通知先。イベントごとにウィンドウを探さないように、フックを掛ける前に設定して quit() で外す
+  static HWND s_hostWindow;
+  //
+  Umapita::StartupProbe m_startupProbe;
+  HINSTANCE m_hInst;
+  Win32::Icon m_trayIcon = nullptr;
+  HACCEL m_hAccel = nullptr;
+  // 時間で動くものはすべてここに載せ、OS のタイマは TIMER_ID の一つだけを一番早い予定に合わせて掛ける
+  Umapita::Scheduler m_scheduler;
+  Umapita::Tracker m_tracker{m_scheduler, [this] { request_tick(); }};
+  std::unique_ptr<MainDialogBox> m_dialog;
+  std::unique_ptr<Umapita::Ipc::Server> m_ipcServer;
+  Umapita::Perf::SharedCounters m_perfCounters{PERF_SHM_NAME};
+  Umapita::WinEventHook m_moveSizeHook;
+  std::vector<Umapita::WinEventHook> m_wakeHooks;  // トラッカーが休止している間だけ掛ける
+  Umapita::Scheduler::TaskId m_tickTask = 0;
+  UmapitaRegistry::ChangeWatcher m_settingWatcher;
+  std::uint64_t m_ticks = 0;
+  std::uint64_t m_statusChanges = 0;
+
+  //
+  // タスクトレイアイコン
+  //
+  BOOL add_tasktray_icon() {
+    if (!m_trayIcon.get())
+      m_trayIcon = Win32::load_icon_image(m_hInst, MAKEINTRESOURCE(IDI_UMAPITA), 16, 16, 0);
+    auto nid = Win32::make_sized_pod<NOTIFYICONDATA>();
+    nid.hWnd = get_window().get();
+    nid.uID = TASKTRAY_ID;
+    nid.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
+    nid.uCallbackMessage = WM_TASKTRAY;
+    nid.hIcon = m_trayIcon.get();
+    LoadString(m_hInst, IDS_TASKTRAY_TIP, nid.szTip, std::size(nid.szTip));
+    return Shell_NotifyIcon(NIM_ADD, &nid);
+  }
+  void delete_tasktray_icon() {
+    auto nid = Win32::make_sized_pod<NOTIFYICONDATA>();
+    nid.hWnd = get_window().get();
+    nid.uID = TASKTRAY_ID;
+    Shell_NotifyIcon(NIM_DELETE, &nid);
+  }
+
+  //
+  // メインダイアログの生成と破棄
+  //
+  static SIZE_T get_working_set_size() {
+    auto pmc = Win32::make_sized_pod<PROCESS_MEMORY_COUNTERS>();
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof (pmc)))
+      return 0;
+    return pmc.WorkingSetSize;
+  }
+
+  void open_dialog() {
+    if (!m_dialog) {
+      Log::info(TEXT("create main dialog"));
+      if (!m_hAccel)
+        m_hAccel = LoadAccelerators(m_hInst, MAKEINTRESOURCE(IDA_UMAPITA));
+      m_dialog = std::make_unique<MainDialogBox>(m_hInst, get_window(), m_tracker);
+    }
+  }
+
+  void close_dialog() {
+    if (m_dialog) {
+      auto before = get_working_set_size();
+      m_dialog->get_window().destroy();
+      m_dialog.reset();
+      // 解放したページをワーキングセットから追い出して、差分が見えるようにする
+      SetProcessWorkingSetSize(GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+      auto after = get_working_set_size();
+      Log::info(TEXT("main dialog destroyed: working set %luKB -> %luKB (%ldKB)"),
+                static_cast<unsigned long>(before / 1024), static_cast<unsigned long>(after / 1024),
+                static_cast<long>(after / 1024) - static_cast<long>(before / 1024));
+    }
+  }
+
+  bool is_dialog_visible() const {
+    return m_dialog && m_dialog->get_window().is_visible();
+  }
+
+  // IDC_SELECT_PROFILE (CBS_SORT) と同じ順序のプロファイル一覧
+  static std::vector<Win32::tstring> enum_sorted_profile() {
+    auto ps = UmapitaRegistry::enum_profile();
+    std::sort(ps.begin(), ps.end(), [](auto const &lhs, auto const &rhs) { return lstrcmpi(lhs.c_str(), rhs.c_str()) < 0; });
+    return ps;
+  }
+
+  void change_profile(const Win32::tstring &name) {
+    if (m_dialog) {
+      // enterCount が 0 でない場合、モーダルダイアログが開いている可能性があるので送らない。
+      // モーダルダイアログが開いているときに送ると、別のモーダルダイアログが開いたり、いろいろ嫌なことが起こる。
+      if (m_dialog->is_idle())
+        m_dialog->request_profile(name);
+      return;
+    }
+    if (m_tracker.setting().common.isCurrentProfileChanged) {
+      // 保存するかどうかの確認が必要なので、ダイアログを作り直して任せる
+      open_dialog();
+      m_dialog->request_profile(name);
+      return;
+    }
+    Log::debug(TEXT("selected: %ls"), name.c_str());
+    m_tracker.load_profile(name);
+  }
+
+  void select_profile(int n) {
+    auto ps = enum_sorted_profile();
+    if (n < 0 || static_cast<std::size_t>(n) >= ps.size()) {
+      Log::info(TEXT("profile %d is not valid"), n);
+      return;
+    }
+    change_profile(ps[n]);
+  }
+
+  void select_next_profile(int step) {
+    auto ps = enum_sorted_profile();
+    if (ps.empty())
+      return;
+    auto const &current = m_tracker.setting().common.currentProfileName;
+    auto found = std::find(ps.begin(), ps.end(), current);
+    int n = found == ps.end() ? (step > 0 ? -1 : 0) : found - ps.begin();
+    int size = ps.size();
+    change_profile(ps[((n + step) % size + size) % size]);
+  }
+
+  void dispatch_hot_key(const Umapita::HotKeyAction &action) {
+    switch (action.kind) {
+    case Umapita::HotKeyAction::SelectByIndex:
+      select_profile(action.arg0);
+      break;
+    case Umapita::HotKeyAction::SelectByName:
+      change_profile(action.name);
+      break;
+    case Umapita::HotKeyAction::Next:
+      select_next_profile(1);
+      break;
+    case Umapita::HotKeyAction::Previous:
+      select_next_profile(-1);
+      break;
+    case Umapita::HotKeyAction::ToggleEnabled: {
+      // モーダルダイアログが開いている間に設定を書き換えると、ダイアログ側の保存や再読み込みで上書きされる
+      if (m_dialog && !m_dialog->is_idle())
+        break;
+      auto &isEnabled = m_tracker.setting().common.isEnabled;
+      isEnabled = !isEnabled;
+      Log::info(TEXT("enabled: %d"), static_cast<int>(isEnabled));
+      m_tracker.invalidate();
+      if (m_dialog && m_dialog->is_idle())
+        m_dialog->reload_controls();
+      break;
+    }
+    case Umapita::HotKeyAction::Nudge:
+      if (m_dialog && !m_dialog->is_idle())
+        break;
+      m_tracker.nudge(action.arg0, action.arg1);
+      if (m_dialog && m_dialog->is_idle())
+        m_dialog->reload_controls();
+      break;
+    }
+  }
+
+  //
+  // IPC
+  //
+  void publish_ipc_status() {
+    if (!m_ipcServer)
+      return;
+    auto const &ts = m_tracker.last_target_status();
+    auto const &common = m_tracker.setting().common;
+    Umapita::Ipc::Status status;
+    status.hasTarget = !!ts.window;
+    status.isEnabled = common.isEnabled;
+    status.isFocusOn = ts.window && ts.isFocusOn;
+    status.isHorizontal = Win32::width(ts.clientRect) > Win32::height(ts.clientRect);
+    auto copy_rect = [](std::int32_t (&dst)[4], const RECT &src) {
+                       dst[0] = src.left; dst[1] = src.top; dst[2] = src.right; dst[3] = src.bottom;
+                     };
+    copy_rect(status.windowRect, ts.windowRect);
+    copy_rect(status.clientRect, ts.clientRect);
+    status.profileName.assign(common.currentProfileName.begin(), common.currentProfileName.end());
+
+    auto const &hk = m_tracker.hot_keys().counters();
+    Umapita::Ipc::Metrics metrics;
+    metrics.ticks = m_ticks;
+    metrics.statusChanges = m_statusChanges;
+    metrics.hotKeyRegisterCalls = hk.registerCalls;
+    metrics.hotKeyUnregisterCalls = hk.unregisterCalls;
+    metrics.hotKeyRegisterFailures = hk.registerFailures;
+    metrics.hotKeyDispatches = hk.dispatches;
+    m_ipcServer->publish(status, metrics);
+  }
+
+  MaybeResult h_ipc_command() {
+    Umapita::Ipc::Server::Command command;
+    while (m_ipcServer && m_ipcServer->pop_command(command)) {
+      switch (command.kind) {
+      case Umapita::Ipc::Server::Command::SwitchProfile: {
+        Win32::tstring name(command.profileName.begin(), command.profileName.end());
+        Log::debug(TEXT("IPC: switch profile to %ls"), name.c_str());
+        change_profile(name);
+        break;
+      }
+      case Umapita::Ipc::Server::Command::ApplyNow:
+        Log::debug(TEXT("IPC: apply now"));
+        m_tracker.invalidate();
+        break;
+      }
+    }
+    // 待たずにすぐ反映する
+    request_tick();
+    return 0;
+  }
+
+  void quit() {
+    m_moveSizeHook = Umapita::WinEventHook{};
+    m_wakeHooks.clear();
+    s_hostWindow = nullptr;
+    m_ipcServer.reset();
+    m_tracker.save_global_setting();
+    delete_tasktray_icon();
+    get_window().kill_timer(TIMER_ID);
+    m_tracker.disarm_hot_keys(get_window());
+    if (m_dialog) {
+      m_dialog->get_window().destroy();
+      m_dialog.reset();
+    }
+    auto window = get_window();
+    restore_window_proc();
+    window.destroy();
+    PostQuitMessage(0);
+  }
+
+  //
+  // メッセージハンドラ
+  //
+  MaybeResult h_command(Window, UINT, WPARAM wParam, LPARAM) {
+    switch (LOWORD(wParam)) {
+    case IDC_SHOW:
+      Log::debug(TEXT("IDC_SHOW received"));
+      open_dialog();
+      m_dialog->get_window().post(WM_COMMAND, IDC_SHOW, 0);
+      return 0;
+    case IDC_HIDE:
+      // ダイアログが自分を隠した後に送ってくる
+      if (m_tracker.setting().common.isLowMemoryMode && m_dialog && !is_dialog_visible() && m_dialog->is_idle())
+        close_dialog();
+      return 0;
+    case IDC_LOW_MEMORY_MODE: {
+      auto &isLowMemoryMode = m_tracker.setting().common.isLowMemoryMode;
+      isLowMemoryMode = !isLowMemoryMode;
+      Log::info(TEXT("low memory mode: %d"), static_cast<int>(isLowMemoryMode));
+      if (isLowMemoryMode && m_dialog && !is_dialog_visible() && m_dialog->is_idle())
+        close_dialog();
+      return 0;
+    }
+    case IDC_TILING_MODE: {
+      auto &isTilingMode = m_tracker.setting().common.isTilingMode;
+      isTilingMode = !isTilingMode;
+      Log::info(TEXT("tiling mode: %d"), static_cast<int>(isTilingMode));
+      m_tracker.invalidate();
+      return 0;
+    }
+    case IDC_ADOPT_DROPPED_POSITION: {
+      auto &isAdoptDroppedPosition = m_tracker.setting().common.isAdoptDroppedPosition;
+      isAdoptDroppedPosition = !isAdoptDroppedPosition;
+      Log::info(TEXT("adopt dropped position: %d"), static_cast<int>(isAdoptDroppedPosition));
+      return 0;
+    }
+    case IDC_QUIT:
+      Log::debug(TEXT("IDC_QUIT received"));
+      quit();
+      return 0;
+    }
+    return 0;
+  }
+
+  MaybeResult h_tasktray(Window, UINT, WPARAM, LPARAM lParam) {
+    switch (lParam) {
+    case WM_RBUTTONDOWN: {
+      TPMPARAMS tpmp = Win32::make_sized_pod<TPMPARAMS>(), *pTpmp = nullptr;
+      if (auto shell = Window::find(TEXT("Shell_TrayWnd"), nullptr); shell) {
+        auto rect = shell.get_window_rect();
+        tpmp.rcExclude = rect;
+        pTpmp = &tpmp;
+      }
+      show_popup_menu(get_window(), m_tracker.setting().common, pTpmp);
+      return 0;
+    }
+
+    case WM_LBUTTONDOWN:
+      // show / hide main dialog
+      if (is_dialog_visible())
+        m_dialog->get_window().post(WM_SYSCOMMAND, SC_MINIMIZE, 0);
+      else
+        get_window().post(WM_COMMAND, IDC_SHOW, 0);
+      return 0;
+    }
+    return 0;
+  }
+
+  //
+  // スケジューラ
+  //
+  void arm_timer() {
+    auto wake = m_scheduler.next_wake();
+    if (!wake) {
+      get_window().kill_timer(TIMER_ID);
+      return;
+    }
+    auto delay = static_cast<UINT>(std::clamp<Umapita::Scheduler::Time>(wake->delay, USER_TIMER_MINIMUM, USER_TIMER_MAXIMUM));
+    auto tolerance = static_cast<ULONG>(std::min<Umapita::Scheduler::Time>(wake->tolerance, TIMERV_COALESCING_MAX));
+    if (!SetCoalescableTimer(get_window().get(), TIMER_ID, delay, nullptr, tolerance))
+      get_window().set_timer(TIMER_ID, delay, nullptr);
+  }
+
+  void schedule_tick(UINT delay, UINT slack) {
+    m_scheduler.cancel(m_tickTask);
+    m_tickTask = m_scheduler.schedule_once(delay, slack, [this] { tick(); });
+  }
+
+  // レジストリの hotKeys が外から書き換えられたら読み直す
+  void reload_hot_keys_if_changed() {
+    if (!m_settingWatcher.poll())
+      return;
+    auto hotKeys = UmapitaRegistry::load_global_setting().common.hotKeys;
+    auto &current = m_tracker.setting().common.hotKeys;
+    if (hotKeys == current)
+      return;
+    Log::info(TEXT("hot keys changed: \"%ls\""), hotKeys.c_str());
+    current = std::move(hotKeys);
+    m_tracker.reload_hot_keys();
+  }
+
+  // 次の周期を待たずにすぐターゲットを確かめる
+  void request_tick() {
+    schedule_tick(0, 0);
+    get_window().post(WM_TIMER, TIMER_ID, 0);
+  }
+
+  MaybeResult h_timer() {
+    m_scheduler.run_due();
+    arm_timer();
+    return 0;
+  }
+
+  void tick() {
+    auto changes = m_tracker.tick(get_window());
+    m_ticks++;
+    if (changes != Umapita::TargetChange::None) {
+      m_statusChanges++;
+      if (m_tracker.last_target_status().window && m_tracker.setting().common.isEnabled)
+        m_startupProbe.mark_first_placement();
+    }
+    publish_ipc_status();
+    m_perfCounters.publish(Umapita::Perf::local_counters());
+    if (m_dialog)
+      m_dialog->update(changes);
+    update_wake_hooks();
+    // 休止中はイベントで起こされるので、取りこぼしの保険として間隔を空ける
+    if (m_tracker.is_dormant())
+      schedule_tick(DORMANT_TIMER_PERIOD, DORMANT_TIMER_SLACK);
+    else
+      schedule_tick(TIMER_PERIOD, TIMER_SLACK);
+  }
+
+  void update_wake_hooks() {
+    auto isDormant = m_tracker.is_dormant();
+    if (isDormant == !m_wakeHooks.empty())
+      return;
+    m_wakeHooks.clear();
+    if (!isDormant)
+      return;
+    DWORD processId = 0;
+    GetWindowThreadProcessId(m_tracker.last_target_status().window.get(), &processId);
+    if (!processId)
+      return;
+    Log::debug(TEXT("dormant: waiting for events from process %lu"), processId);
+    m_wakeHooks.emplace_back(EVENT_SYSTEM_MINIMIZESTART, EVENT_SYSTEM_MINIMIZEEND, win_event_proc, processId);
+    m_wakeHooks.emplace_back(EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED, win_event_proc, processId);
+    // 全画面から抜けるときは別のプロセスのウィンドウが前面に来るので、前面の変化はすべてのプロセスから受け取る
+    m_wakeHooks.emplace_back(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, win_event_proc);
+  }
+
+  // WinEvent のコールバックはユーザデータを持てないので、s_hostWindow にポストする
+  static void CALLBACK win_event_proc(HWINEVENTHOOK, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD, DWORD) {
+    if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hWnd || !s_hostWindow)
+      return;
+    Window{s_hostWindow}.post(WM_TARGET_EVENT, event, reinterpret_cast<LPARAM>(hWnd));
+  }
+
+  MaybeResult h_target_event(Window, UINT, WPARAM wParam, LPARAM lParam) {
+    auto hWnd = reinterpret_cast<HWND>(lParam);
+    switch (wParam) {
+    case EVENT_SYSTEM_MOVESIZESTART:
+      m_tracker.begin_move_size(hWnd);
+      break;
+    case EVENT_SYSTEM_MOVESIZEEND:
+      if (!m_tracker.is_in_move_size())
+        break;
+      if (m_tracker.end_move_size(hWnd, m_tracker.setting().common.isAdoptDroppedPosition) && m_dialog && m_dialog->is_idle())
+        m_dialog->reload_controls();
+      // ドラッグ中に止めていた配置をすぐに一度だけ行う
+      request_tick();
+      break;
+    case EVENT_SYSTEM_MINIMIZEEND:
+    case EVENT_OBJECT_UNCLOAKED:
+    case EVENT_SYSTEM_FOREGROUND:
+      // 休止の理由がなくなったかもしれないので、次の tick を待たずに確かめる
+      if (m_tracker.is_dormant()) {
+        Umapita::Perf::bump(Umapita::Perf::Counter::DormantWakeups);
+        request_tick();
+      }
+      break;
+    }
+    return 0;
+  }
+
+  // 押されたキーを前面のアプリに送る。修飾キーは押されたままなので、キーだけを送ればよい
+  static void resend_key(UINT vk) {
+    INPUT inputs[2] = {};
+    for (auto &input : inputs) {
+      input.type = INPUT_KEYBOARD;
+      input.ki.wVk = static_cast<WORD>(vk);
+    }
+    inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+    if (SendInput(std::size(inputs), inputs, sizeof (INPUT)) != std::size(inputs))
+      Log::warning(TEXT("cannot resend key %02X: %lu"), vk, GetLastError());
+  }
+
+  MaybeResult h_hotkey(Window, UINT, WPARAM wParam, LPARAM lParam) {
+    Log::debug(TEXT("WM_HOTKEY: wParam=%X, lParam=%X"), static_cast<unsigned>(wParam), static_cast<unsigned>(lParam));
+    // フォーカスが外れた直後の猶予中に押されたものは他のアプリ宛てだったので、登録をすぐに外して送り直す。
+    // 前回の tick の時点ではまだフォーカスがあったかもしれないので、状態によらずに外す（次の tick で整う）
+    if (GetForegroundWindow() != m_tracker.last_target_status().window.get()) {
+      m_tracker.disarm_hot_keys(get_window());
+      resend_key(HIWORD(lParam));
+      return 0;
+    }
+    // ディスパッチ中にテーブルが差し替えられてもいいようにコピーしておく
+    if (auto action = m_tracker.hot_keys().find(wParam); action)
+      dispatch_hot_key(Umapita::HotKeyAction{*action});
+    return 0;
+  }
+
+  static void register_host_window_class(HINSTANCE hInst) {
+    auto wc = Win32::make_sized_pod<WNDCLASSEX>();
+    wc.lpfnWndProc = DefWindowProc;
+    wc.hInstance = hInst;
+    wc.lpszClassName = TEXT(UMAPITA_HOST_WINDOW_CLASS);
+    RegisterClassEx(&wc);
+  }
+
+public:
+  HostWindow(HINSTANCE hInst) : m_hInst{hInst} {
+    if (!s_msgTaskbarCreated) {
+      register_host_window_class(hInst);
+      s_msgTaskbarCreated = RegisterWindowMessage(TEXT("TaskbarCreated"));
+    }
+
+    register_message(WM_COMMAND, Win32::Handler::binder(*this, h_command));
+    register_message(s_msgTaskbarCreated, [this] { add_tasktray_icon(); return 0; });
+    register_message(WM_TASKTRAY, Win32::Handler::binder(*this, h_tasktray));
+    register_message(WM_TIMER, Win32::Handler::binder(*this, h_timer));
+    register_message(WM_HOTKEY, Win32::Handler::binder(*this, h_hotkey));
+    register_message(WM_OPEN_DIALOG, [this] { open_dialog(); return 0; });
+    register_message(WM_IPC_COMMAND, Win32::Handler::binder(*this, h_ipc_command));
+    register_message(WM_TARGET_EVENT, Win32::Handler::binder(*this, h_target_event));
+    register_message(WM_DISPLAYCHANGE, [this] { m_tracker.reset_monitors(); return 0; });
+    register_message(WM_SETTINGCHANGE, [this] { m_tracker.reset_monitors(); return 0; });
+
+    auto hWnd = CreateWindowEx(0, TEXT(UMAPITA_HOST_WINDOW_CLASS), TEXT(""), WS_POPUP, 0, 0, 0, 0, nullptr, nullptr, hInst, nullptr);
+    if (!hWnd) {
+      Log::error(TEXT("cannot create host window: %lu"), GetLastError());
+      return;
+    }
+    override_window_proc(Window{hWnd});
+
+    // トラッカーと現在のプロファイルを先に用意して最初の配置を済ませ、
+    // アイコンやダイアログなどの UI はその後で作る（ポストしたメッセージは順番に処理される）
+    m_tracker.load_global_setting();
+    m_startupProbe.mark_tracker_ready();
+
+    request_tick();
+    get_window().post(s_msgTaskbarCreated, 0, 0);
+    get_window().post(WM_OPEN_DIALOG, 0, 0);
+
+    Umapita::Ipc::Server::Handler ipcHandler;
+    ipcHandler.notify = [host = get_window()]() mutable { host.post(WM_IPC_COMMAND, 0, 0); };
+    ipcHandler.is_profile_existing = [](const std::u16string &name) {
+                                       return UmapitaRegistry::is_profile_existing(Win32::tstring(name.begin(), name.end()));
+                                     };
+    ipcHandler.log = [](Umapita::Ipc::Server::LogLevel level, const char *message) {
+                       if (level == Umapita::Ipc::Server::LogLevel::Warning)
+                         Log::warning(TEXT("%hs"), message);
+                       else
+                         Log::info(TEXT("%hs"), message);
+                     };
+    m_ipcServer = std::make_unique<Umapita::Ipc::Server>(Umapita::Ipc::make_named_pipe_transport(IPC_PIPE_NAME), std::move(ipcHandler));
+    s_hostWindow = get_window().get();
+    // ドラッグ・リサイズはまれにしか起きないので、全プロセス分を受け取ってトラッカー側で選り分ける
+    m_moveSizeHook = Umapita::WinEventHook{EVENT_SYSTEM_MOVESIZESTART, EVENT_SYSTEM_MOVESIZEEND, win_event_proc};
+  }
+
   int message_loop() {
-    auto hAccel = LoadAccelerators(get_window().get_instance(), MAKEINTRESOURCE(IDA_UMAPITA));
+    if (!get_window())
+      return 1;
+
     MSG msg;
-    while (GetMessage(&msg, nullptr, 0, 0)) {
-      if (get_window().translate_accelerator(hAccel, &msg))
-        continue;
-      if (get_window().is_dialog_message(&msg))
-        continue;
-      TranslateMessage(&msg);
-      DispatchMessage(&msg);
+    for (;;) {
+      // レジストリの変更はメッセージと一緒に待つ（周期的に確かめると、休止中も起き続けることになる）
+      auto hEvent = m_settingWatcher.event();
+      auto ret = MsgWaitForMultipleObjectsEx(hEvent ? 1 : 0, &hEvent, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+      if (hEvent && ret == WAIT_OBJECT_0)
+        reload_hot_keys_if_changed();
+      while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        if (msg.message == WM_QUIT)
+          return msg.wParam;
+        if (m_dialog) {
+          auto dialog = m_dialog->get_window();
+          if (dialog.translate_accelerator(m_hAccel, &msg))
+            continue;
+          if (dialog.is_dialog_message(&msg))
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+      }
     }
-
-    return msg.wParam;
   }
 };
 
-Win32::Icon MainDialogBox::s_appIcon = nullptr, MainDialogBox::s_appIconSm = nullptr;
-UINT MainDialogBox::s_msgTaskbarCreated = 0;
+UINT HostWindow::s_msgTaskbarCreated = 0;
+HWND HostWindow::s_hostWindow = nullptr;
 
 
 int WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR lpCmdLine, int nCmdShow) {
-  if (auto w = Window::find(TEXT(UMAPITA_MAIN_WINDOW_CLASS), nullptr); w) {
+  // スクリプトから一度だけ配置したいときは UI を作らずに終わる
+  if (auto ret = Umapita::Headless::run(GetCommandLine()); ret)
+    return *ret;
+
+  if (auto w = Window::find(TEXT(UMAPITA_HOST_WINDOW_CLASS), nullptr); w) {
     w.post(WM_COMMAND, IDC_SHOW, 0);
     return 0;
   }
 
-  return MainDialogBox{hInst}.message_loop();
+  return HostWindow{hInst}.message_loop();
 }
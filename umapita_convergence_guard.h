@@ -0,0 +1,116 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// 配置の収束ガード
+//
+// ゲームや OS が要求したサイズを丸める（最小サイズ、DPI のスナップ、Unity 側の縦横比の強制など）と、
+// 実際の矩形がいつまでも理想の矩形と一致せず、状態が変わるたびに SetWindowPos を繰り返すことになる。
+// そこで最後に要求した矩形と実際に得られた矩形を覚えておき、
+// - 前回と同じ状態から同じ要求をしても同じ結果にしかならないなら、それを「これ以上近づけない位置」として受け入れる (Settled)
+// - 短時間に何度も要求しても落ち着かない（取り合いになっている）なら、しばらく要求を止める (BackingOff)
+// 要求する矩形かウィンドウが変わったら最初からやり直す。
+//
+class ConvergenceGuard {
+public:
+  enum State { Idle, Converging, Settled, BackingOff };
+
+private:
+  static constexpr int MAX_ATTEMPTS = 4;               // FIGHT_WINDOW の間にこれだけ試して落ち着かなければ引く
+  static constexpr ULONGLONG FIGHT_WINDOW = 3000;
+  static constexpr ULONGLONG INITIAL_BACKOFF = 1000;  // 引くたびに倍にする
+  static constexpr ULONGLONG MAX_BACKOFF = 30000;
+
+  HWND m_hWnd = nullptr;
+  RECT m_requested{0, 0, 0, 0};
+  RECT m_obtained{0, 0, 0, 0};
+  int m_attempts = 0;
+  ULONGLONG m_firstAttemptAt = 0;
+  ULONGLONG m_backoffUntil = 0;
+  ULONGLONG m_backoff = INITIAL_BACKOFF;
+  State m_state = Idle;
+
+public:
+  State state() const { return m_state; }
+  // BackingOff のとき、いつ明けるか（GetTickCount64() の時刻）
+  ULONGLONG backoff_until() const { return m_backoffUntil; }
+
+  void reset() {
+    *this = ConvergenceGuard{};
+  }
+
+  // current から requested へ動かしてよいか
+  bool should_attempt(HWND hWnd, const RECT &requested, const RECT &current, ULONGLONG now) {
+    using AM::Win32::Op::operator ==;
+    if (hWnd != m_hWnd || !(requested == m_requested)) {
+      reset();
+      m_hWnd = hWnd;
+      m_requested = requested;
+      m_firstAttemptAt = now;
+      return true;
+    }
+    if (m_state == BackingOff) {
+      Perf::bump(Perf::Counter::ConvergenceSuppressions);
+      return false;
+    }
+    if (m_attempts > 0 && current == m_obtained) {
+      // 前回と同じ状態なので、また同じ結果にしかならない
+      if (m_state != Settled) {
+        AM::Log::info(TEXT("%p: settled at (%ld,%ld)-(%ld,%ld) instead of (%ld,%ld)-(%ld,%ld)"), hWnd,
+                      current.left, current.top, current.right, current.bottom,
+                      requested.left, requested.top, requested.right, requested.bottom);
+        m_state = Settled;
+        Perf::bump(Perf::Counter::ConvergenceSettles);
+      }
+      Perf::bump(Perf::Counter::ConvergenceSuppressions);
+      return false;
+    }
+    if (m_attempts == 0 || now - m_firstAttemptAt > FIGHT_WINDOW) {
+      m_attempts = 0;
+      m_firstAttemptAt = now;
+    }
+    if (m_attempts >= MAX_ATTEMPTS) {
+      AM::Log::warning(TEXT("%p: placement does not converge after %d attempts, backing off for %lu ms"),
+                       hWnd, m_attempts, static_cast<unsigned long>(m_backoff));
+      m_state = BackingOff;
+      m_backoffUntil = now + m_backoff;
+      m_backoff = std::min(m_backoff * 2, MAX_BACKOFF);
+      Perf::bump(Perf::Counter::ConvergenceBackoffs);
+      Perf::bump(Perf::Counter::ConvergenceSuppressions);
+      return false;
+    }
+    return true;
+  }
+
+  // SetWindowPos の直後に実際に得られた矩形を知らせる
+  void on_result(const RECT &obtained) {
+    using AM::Win32::Op::operator ==;
+    m_attempts++;
+    m_obtained = obtained;
+    m_state = obtained == m_requested ? Idle : Converging;
+  }
+
+  // 理想の矩形にいるので動かさなかったことを知らせる。
+  // 前回得られた矩形の記憶は捨てる（残しておくと、後でまたその位置にずらされたときに Settled と誤って動かさなくなる）。
+  // 取り合いを見つけられるように、試行回数とバックオフはそのままにする
+  void on_ideal() {
+    m_obtained = RECT{0, 0, 0, 0};
+    if (m_state != BackingOff)
+      m_state = Idle;
+  }
+
+  // バックオフが明けたら一度だけ true を返す。呼び出し側は再配置を促すこと
+  bool poll_backoff_expired(ULONGLONG now) {
+    if (m_state != BackingOff || now < m_backoffUntil)
+      return false;
+    m_state = Converging;
+    m_attempts = 0;
+    return true;
+  }
+};
+
+// ウィンドウごとの収束ガード（タイル配置では一つずつ別々に収束を見る）
+using ConvergenceGuards = std::unordered_map<HWND, ConvergenceGuard>;
+
+} // namespace Umapita
@@ -9,62 +9,177 @@ class UmapitaCustomGroupBox : public AM::Win32::CustomControl::Template<UmapitaC
   using Base = AM::Win32::CustomControl::Template<UmapitaCustomGroupBox>;
   bool m_isSelected = false;
   HFONT m_hFont = nullptr;
+
   //
-  AM::Win32::CustomControl::MessageHandlers::MaybeResult on_paint(AM::Win32::Window window) {
-    auto p = window.begin_paint();
+  // テキストメトリクスと枠のジオメトリのキャッシュ
+  // WM_SETTEXT, WM_SIZE, set_font() で無効にし、次の WM_PAINT で一度だけ計算し直す。
+  // 描画のたびにテキストやクライアント領域を問い合わせないこと
+  //
+  struct Geometry {
+    bool isValid = false;
+    AM::Win32::tstring text;
+    SIZE clientSize{0, 0};
+    int textX = 0;
+    SIZE textSize{0, 0};
+    RECT labelRect{0, 0, 0, 0};
+    RECT frameRect{0, 0, 0, 0};
+  } m_geometry;
 
-    // テキスト描画
-    auto scopedSelect = AM::Win32::scoped_select_font(p.hdc(), m_hFont); // m_hFont は nullptr でも問題ない
+  //
+  // オフスクリーンバッファ
+  // クライアント領域のサイズが変わらない限り使い回す
+  // m_hPaintRgn は実際に描画する部分（枠とラベル）で、転送時のクリップに使う
+  //
+  HDC m_hMemDC = nullptr;
+  HBITMAP m_hBitmap = nullptr;
+  HGDIOBJ m_hOldBitmap = nullptr;
+  SIZE m_bufferSize{0, 0};
+  HRGN m_hPaintRgn = nullptr;
 
-    TEXTMETRIC tm;
-    GetTextMetrics(p.hdc(), &tm);
+  void release_buffer() {
+    if (m_hMemDC) {
+      SelectObject(m_hMemDC, m_hOldBitmap);
+      DeleteObject(m_hBitmap);
+      DeleteDC(m_hMemDC);
+      m_hMemDC = nullptr;
+      m_hBitmap = nullptr;
+      m_hOldBitmap = nullptr;
+      m_bufferSize = SIZE{0, 0};
+    }
+    if (m_hPaintRgn) {
+      DeleteObject(m_hPaintRgn);
+      m_hPaintRgn = nullptr;
+    }
+  }
+
+  void ensure_buffer(HDC hdc, SIZE size) {
+    if (m_hMemDC && m_bufferSize.cx == size.cx && m_bufferSize.cy == size.cy)
+      return;
+    release_buffer();
+    m_hMemDC = CreateCompatibleDC(hdc);
+    m_hBitmap = CreateCompatibleBitmap(hdc, size.cx, size.cy);
+    m_hOldBitmap = SelectObject(m_hMemDC, m_hBitmap);
+    m_bufferSize = size;
+  }
 
+  // キャッシュが無効ならジオメトリを計算し直す
+  // 計算し直した場合は true を返す
+  bool update_geometry(AM::Win32::Window window, HDC hdc) {
+    auto &g = m_geometry;
+    if (g.isValid)
+      return false;
+
+    auto rect = window.get_client_rect();
+    SIZE clientSize{AM::Win32::width(rect), AM::Win32::height(rect)};
     auto text = window.get_text();
-    int len = text.size();
+    AM::Log::debug(TEXT("group box geometry updated: %ldx%ld"), clientSize.cx, clientSize.cy);
+    auto scopedSelect = AM::Win32::scoped_select_font(hdc, m_hFont); // m_hFont は nullptr でも問題ない
 
-    SIZE size;
-    GetTextExtentPoint32(p.hdc(), text.c_str(), len, &size);
+    TEXTMETRIC tm;
+    GetTextMetrics(hdc, &tm);
 
-    {
-      auto scopedBkMode = AM::Win32::scoped_set_bk_mode(p.hdc(), TRANSPARENT);
-      auto scopedTextColor = AM::Win32::scoped_set_text_color(p.hdc(), GetSysColor(COLOR_WINDOWTEXT));
-      TextOut(p.hdc(), tm.tmAveCharWidth*5/4, 0, text.c_str(), len);
+    SIZE size{0, 0};
+    GetTextExtentPoint32(hdc, text.c_str(), text.size(), &size);
+
+    g.text = std::move(text);
+    g.clientSize = clientSize;
+    g.textX = tm.tmAveCharWidth*5/4;
+    g.textSize = size;
+    // テキスト部分は枠の描画エリアから除外する
+    g.labelRect = g.text.empty() ? RECT{0, 0, 0, 0} : RECT{tm.tmAveCharWidth, 0, tm.tmAveCharWidth*3/2 + size.cx, size.cy};
+    g.frameRect = RECT{rect.left, rect.top+size.cy/2, rect.right, rect.bottom};
+
+    // 転送する領域 = 枠（選択状態の幅 2 でカバーできる分）+ ラベル
+    if (m_hPaintRgn)
+      DeleteObject(m_hPaintRgn);
+    auto const &f = g.frameRect;
+    m_hPaintRgn = CreateRectRgn(f.left, f.top, f.right, f.bottom);
+    auto inner = AM::Win32::create_rect_region(f.left+2, f.top+2, f.right-2, f.bottom-2);
+    CombineRgn(m_hPaintRgn, m_hPaintRgn, inner.get(), RGN_DIFF);
+    auto label = AM::Win32::create_rect_region(g.labelRect.left, g.labelRect.top, g.labelRect.right, g.labelRect.bottom);
+    CombineRgn(m_hPaintRgn, m_hPaintRgn, label.get(), RGN_OR);
+    g.isValid = true;
+    return true;
+  }
+
+  void render(AM::Win32::Window window, HDC hdc) {
+    auto const &g = m_geometry;
+    RECT all{0, 0, g.clientSize.cx, g.clientSize.cy};
+
+    // 背景は親に問い合わせる（静的コントロールと同じ扱い）
+    auto hBkBrush = reinterpret_cast<HBRUSH>(SendMessage(window.get_parent().get(), WM_CTLCOLORSTATIC,
+                                                         reinterpret_cast<WPARAM>(hdc), window.to<LPARAM>()));
+    FillRect(hdc, &all, hBkBrush ? hBkBrush : GetSysColorBrush(COLOR_3DFACE));
+
+    // テキスト描画
+    if (!g.text.empty()) {
+      auto scopedSelect = AM::Win32::scoped_select_font(hdc, m_hFont);
+      auto scopedBkMode = AM::Win32::scoped_set_bk_mode(hdc, TRANSPARENT);
+      auto scopedTextColor = AM::Win32::scoped_set_text_color(hdc, GetSysColor(COLOR_WINDOWTEXT));
+      TextOut(hdc, g.textX, 0, g.text.c_str(), g.text.size());
     }
 
     // 枠描画
-    auto rect = window.get_client_rect();
-    if (len) {
-      // テキスト部分を描画エリアから除外する
-      auto r = AM::Win32::create_rect_region(tm.tmAveCharWidth, 0, tm.tmAveCharWidth*3/2 + size.cx, size.cy);
-      ExtSelectClipRgn(p.hdc(), r.get(), RGN_DIFF);
-    }
+    auto const &l = g.labelRect;
+    if (!g.text.empty())
+      ExcludeClipRect(hdc, l.left, l.top, l.right, l.bottom);
     {
       // 選択状態のときは黒くて幅 2 のラインを、非選択状態のときは灰色で幅 1 のラインを描く
-      auto r = AM::Win32::create_rect_region(rect.left, rect.top+size.cy/2, rect.right, rect.bottom);
+      auto const &f = g.frameRect;
+      auto r = AM::Win32::create_rect_region(f.left, f.top, f.right, f.bottom);
       auto hBrush = reinterpret_cast<HBRUSH>(GetStockObject(m_isSelected ? BLACK_BRUSH : LTGRAY_BRUSH));
       auto w = m_isSelected ? 2 : 1;
-      FrameRgn(p.hdc(), r.get(), hBrush, w, w);
+      FrameRgn(hdc, r.get(), hBrush, w, w);
     }
+    SelectClipRgn(hdc, nullptr);
+  }
+
+  //
+  AM::Win32::CustomControl::MessageHandlers::MaybeResult on_paint(AM::Win32::Window window) {
+    auto p = window.begin_paint();
+
+    update_geometry(window, p.hdc());
+    auto const &g = m_geometry;
+    if (g.clientSize.cx <= 0 || g.clientSize.cy <= 0)
+      return 0;
+
+    // オフスクリーンに描いてから枠とラベルの部分だけを転送する
+    ensure_buffer(p.hdc(), g.clientSize);
+    render(window, m_hMemDC);
+    SelectClipRgn(p.hdc(), m_hPaintRgn);
+    BitBlt(p.hdc(), 0, 0, g.clientSize.cx, g.clientSize.cy, m_hMemDC, 0, 0, SRCCOPY);
     SelectClipRgn(p.hdc(), nullptr);
     return 0;
   }
+  // 元のウィンドウプロシージャにも処理させる
+  AM::Win32::CustomControl::MessageHandlers::MaybeResult on_geometry_changed() {
+    m_geometry.isValid = false;
+    redraw();
+    return {};
+  }
   void redraw() {
-    if (this->get_window()) {
-      auto parent = this->get_window().get_parent();
-      auto rect = this->get_window().get_window_rect();
-      MapWindowPoints(HWND_DESKTOP, parent.get(), reinterpret_cast<LPPOINT>(&rect), 2);
-      parent.invalidate_rect(rect, true);
-      parent.update_window();
-    }
+    // 背景は自前で塗るので親を再描画する必要はない
+    // 同期的に描画せず、次の WM_PAINT にまとめてもらう
+    if (this->get_window())
+      InvalidateRect(this->get_window().get(), nullptr, false);
   }
 public:
   UmapitaCustomGroupBox() {
     register_message(WM_PAINT, AM::Win32::Handler::binder(*this, on_paint));
     register_message(WM_GETDLGCODE, []() { return DLGC_STATIC; });
     register_message(WM_NCHITTEST, []() { return HTTRANSPARENT; });
+    register_message(WM_SETTEXT, AM::Win32::Handler::binder(*this, on_geometry_changed));
+    register_message(WM_SIZE, AM::Win32::Handler::binder(*this, on_geometry_changed));
+  }
+  ~UmapitaCustomGroupBox() {
+    release_buffer();
   }
   using Base::override_window_proc;
-  using Base::restore_window_proc;
+  void restore_window_proc() {
+    Base::restore_window_proc();
+    release_buffer();
+    m_geometry.isValid = false;
+  }
   void set_selected(bool isSelected) {
     if ((m_isSelected && !isSelected) || (!m_isSelected && isSelected)) {
       m_isSelected = isSelected;
@@ -72,7 +187,10 @@ public:
     }
   }
   void set_font(HFONT hFont) {
-    m_hFont = hFont;
+    if (m_hFont != hFont) {
+      m_hFont = hFont;
+      m_geometry.isValid = false;
+    }
     redraw();
   }
 };
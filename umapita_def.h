@@ -3,14 +3,26 @@
 constexpr UINT WM_TASKTRAY = WM_USER+0x1000;
 constexpr UINT WM_CHANGE_PROFILE = WM_USER+0x1001;
 constexpr UINT WM_KEYHOOK = WM_USER+0x1002;
+constexpr UINT WM_OPEN_DIALOG = WM_USER+0x1003;
+constexpr UINT WM_IPC_COMMAND = WM_USER+0x1004;
+constexpr UINT WM_TARGET_EVENT = WM_USER+0x1005;  // wParam = WinEvent のイベント, lParam = HWND
 constexpr UINT TASKTRAY_ID = 1;
 constexpr UINT TIMER_ID = 1;
 constexpr UINT TIMER_PERIOD = 200;
+constexpr UINT TIMER_SLACK = 20;             // この分だけ遅れてもよいので、他のタイマとまとめて起こしてもらう
+constexpr UINT DORMANT_TIMER_PERIOD = 2000;  // ターゲットが最小化・全画面・クローク中のときの保険の周期
+constexpr UINT DORMANT_TIMER_SLACK = 1000;
 constexpr int HOT_KEY_ID_BASE = 1;
+constexpr UINT HOT_KEY_RELEASE_DELAY = 500;     // フォーカスが外れてからホットキーの登録を外すまでの猶予
+constexpr UINT CONVERGENCE_RETRY_SLACK = 100;   // 配置の取り合いで引いた後、やり直すのはこの分だけ遅れてもよい
 constexpr TCHAR TARGET_WINDOW_CLASS[] = TEXT("UnityWndClass");
 constexpr TCHAR TARGET_WINDOW_NAME[] = TEXT("umamusume");
 constexpr int MIN_WIDTH = 100;
 constexpr int MIN_HEIGHT = 100;
+// PerOrientation::monitorNumber の特別な値。ターゲットウィンドウが一番広く重なっているモニタに合わせる
+constexpr LONG MONITOR_NUMBER_FOLLOW = -2;
+constexpr TCHAR IPC_PIPE_NAME[] = TEXT("\\\\.\\pipe\\umapita");
+constexpr TCHAR PERF_SHM_NAME[] = TEXT("Local\\umapita.perf");
 
 // reinterpret_cast は constexpr ではないので constexpr auto REG_ROOT_KEY = HKEY_CURRENT_USER; だと通らない
 #define REG_ROOT_KEY HKEY_CURRENT_USER
@@ -0,0 +1,200 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_setting.h"
+#include "umapita_registry.h"
+#include "umapita_monitor_index.h"
+#include "umapita_monitors.h"
+#include "umapita_target_status.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
+#include "umapita_ipc_protocol.h"
+#include "umapita_headless.h"
+#include "umapita_res.h"
+
+using namespace Umapita;
+using namespace AM;
+
+namespace {
+
+constexpr DWORD PIPE_WAIT_TIMEOUT = 1000;
+
+class Stopwatch {
+  LARGE_INTEGER m_frequency;
+  LARGE_INTEGER m_start;
+
+public:
+  Stopwatch() {
+    QueryPerformanceFrequency(&m_frequency);
+    QueryPerformanceCounter(&m_start);
+  }
+  double lap_ms() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    auto ret = static_cast<double>(now.QuadPart - m_start.QuadPart) * 1000.0 / static_cast<double>(m_frequency.QuadPart);
+    m_start = now;
+    return ret;
+  }
+};
+
+// プロセスが生成されてからの時間（ローダや CRT の初期化も含む）
+double ms_since_process_creation() {
+  FILETIME creation, exit, kernel, user, now;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0.;
+  GetSystemTimePreciseAsFileTime(&now);
+  auto to_u64 = [](const FILETIME &ft) { return (static_cast<ULONGLONG>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+  return static_cast<double>(to_u64(now) - to_u64(creation)) / 10000.;
+}
+
+//
+// 常駐しているインスタンスに配置を頼む
+//
+bool transact(HANDLE hPipe, Ipc::Opcode opcode, const Ipc::Buffer &payload, Ipc::StatusCode &status) {
+  auto request = Ipc::encode_message(static_cast<std::uint16_t>(opcode), payload);
+  DWORD written = 0;
+  if (!WriteFile(hPipe, request.data(), request.size(), &written, nullptr) || written != request.size())
+    return false;
+  std::uint8_t raw[Ipc::HEADER_SIZE];
+  DWORD read = 0;
+  if (!ReadFile(hPipe, raw, sizeof (raw), &read, nullptr) || read != sizeof (raw))
+    return false;
+  Ipc::Header header;
+  if (!Ipc::decode_header(raw, header))
+    return false;
+  // ペイロードは使わないが、読み捨てておかないと次の応答とずれる
+  Ipc::Buffer rest(header.length);
+  if (header.length && (!ReadFile(hPipe, rest.data(), rest.size(), &read, nullptr) || read != rest.size()))
+    return false;
+  status = static_cast<Ipc::StatusCode>(header.code);
+  return true;
+}
+
+int forward(const std::optional<Win32::tstring> &profileName) {
+  if (!WaitNamedPipe(IPC_PIPE_NAME, PIPE_WAIT_TIMEOUT)) {
+    Log::error(TEXT("headless: the running instance does not answer: %lu"), GetLastError());
+    return Headless::ForwardFailed;
+  }
+  auto hPipe = CreateFile(IPC_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+  if (hPipe == INVALID_HANDLE_VALUE) {
+    Log::error(TEXT("headless: cannot open pipe: %lu"), GetLastError());
+    return Headless::ForwardFailed;
+  }
+  // プロファイルを切り替えれば常駐側が再配置するので、名前がなければ再配置だけを頼む
+  Ipc::Buffer payload;
+  auto opcode = Ipc::Opcode::ApplyNow;
+  if (profileName) {
+    Ipc::Writer{payload}.str(std::u16string(profileName->begin(), profileName->end()));
+    opcode = Ipc::Opcode::SwitchProfile;
+  }
+  auto status = Ipc::StatusCode::Ok;
+  auto isOk = transact(hPipe, opcode, payload, status);
+  CloseHandle(hPipe);
+  if (!isOk) {
+    Log::error(TEXT("headless: IPC failed"));
+    return Headless::ForwardFailed;
+  }
+  if (status == Ipc::StatusCode::NotFound) {
+    Log::error(TEXT("headless: profile \"%ls\" is not found"), profileName->c_str());
+    return Headless::ProfileNotFound;
+  }
+  if (status != Ipc::StatusCode::Ok && status != Ipc::StatusCode::Accepted) {
+    Log::error(TEXT("headless: the running instance refused the request: %u"), static_cast<unsigned>(status));
+    return Headless::ForwardFailed;
+  }
+  Log::info(TEXT("headless: forwarded to the running instance"));
+  return Headless::Ok;
+}
+
+//
+// 自分で配置する
+//
+struct Timings {
+  double profile = 0., monitors = 0., target = 0., adjust = 0.;
+  double total() const { return profile + monitors + target + adjust; }
+};
+
+int apply_locally(const std::optional<Win32::tstring> &profileName, Timings &t) {
+  Stopwatch sw;
+  if (profileName && !UmapitaRegistry::is_profile_existing(*profileName)) {
+    Log::error(TEXT("headless: profile \"%ls\" is not found"), profileName->c_str());
+    return Headless::ProfileNotFound;
+  }
+  // レジストリの直下が最後に使っていたプロファイルの内容
+  auto profile = profileName ? UmapitaRegistry::load_setting(*profileName) : UmapitaRegistry::load_setting(nullptr);
+  t.profile = sw.lap_ms();
+  UmapitaMonitors monitors;
+  t.monitors = sw.lap_ms();
+  auto ts = TargetStatus::get(TARGET_WINDOW_CLASS, TARGET_WINDOW_NAME);
+  t.target = sw.lap_ms();
+  if (!ts.window) {
+    Log::info(TEXT("headless: target window is not found"));
+    return Headless::TargetNotFound;
+  }
+  ConvergenceGuard guard;
+  ts.adjust(monitors, profile, guard);
+  t.adjust = sw.lap_ms();
+  return Headless::Ok;
+}
+
+int apply(const std::optional<Win32::tstring> &profileName) {
+  if (Win32::Window::find(TEXT(UMAPITA_HOST_WINDOW_CLASS), nullptr))
+    return forward(profileName);
+
+  Timings t;
+  auto ret = apply_locally(profileName, t);
+  auto total = ms_since_process_creation();
+  Log::info(TEXT("headless: profile %.3fms, monitors %.3fms, target %.3fms, adjust %.3fms, since process creation %.3fms (budget %.1fms)"),
+            t.profile, t.monitors, t.target, t.adjust, total, Headless::STARTUP_BUDGET_MS);
+  if (total > Headless::STARTUP_BUDGET_MS)
+    Log::warning(TEXT("headless: startup budget exceeded"));
+  return ret;
+}
+
+// 配置の手順を count 回繰り返して中央値を予算と比べる。二回目以降はすでに配置済みなので SetWindowPos は呼ばれない
+int bench(int count) {
+  std::vector<double> samples;
+  for (auto i=0; i<count; i++) {
+    Timings t;
+    if (auto ret = apply_locally(std::nullopt, t); ret != Headless::Ok)
+      return ret;
+    samples.push_back(t.total());
+  }
+  std::sort(samples.begin(), samples.end());
+  auto median = samples[samples.size() / 2];
+  Log::info(TEXT("headless bench: n=%d, min %.3fms, median %.3fms, max %.3fms (budget %.1fms)"),
+            count, samples.front(), median, samples.back(), Headless::STARTUP_BUDGET_MS);
+  return median > Headless::STARTUP_BUDGET_MS ? Headless::OverBudget : Headless::Ok;
+}
+
+} // namespace
+
+std::optional<int> Headless::run(Win32::StrPtr commandLine) {
+  int argc = 0;
+  auto argv = CommandLineToArgvW(commandLine.ptr, &argc);
+  if (!argv)
+    return std::nullopt;
+  std::vector<Win32::tstring> args(argv, argv + argc);
+  LocalFree(argv);
+  if (args.size() < 2)
+    return std::nullopt;
+
+  auto const &mode = args[1];
+  if (lstrcmpi(mode.c_str(), TEXT("/apply")) == 0) {
+    if (args.size() > 3)
+      return BadArguments;
+    return apply(args.size() == 3 ? std::optional<Win32::tstring>{args[2]} : std::nullopt);
+  }
+  if (lstrcmpi(mode.c_str(), TEXT("/bench-apply")) == 0) {
+    auto count = args.size() >= 3 ? _ttoi(args[2].c_str()) : DEFAULT_BENCH_COUNT;
+    if (args.size() > 3 || count <= 0)
+      return BadArguments;
+    if (Win32::Window::find(TEXT(UMAPITA_HOST_WINDOW_CLASS), nullptr)) {
+      // 常駐側と配置を取り合うと計測にならない
+      Log::error(TEXT("headless bench: quit the running instance first"));
+      return BadArguments;
+    }
+    return bench(count);
+  }
+  return std::nullopt;
+}
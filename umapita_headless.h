@@ -0,0 +1,30 @@
+#pragma once
+
+namespace Umapita::Headless {
+
+//
+// UI を作らずに一度だけ配置して終了するモード
+//
+//   umapita.exe /apply [プロファイル名]        … 配置して終了する
+//   umapita.exe /bench-apply [回数]           … 常駐していない状態での配置を何度か計って予算と比べる
+//
+// 常駐しているインスタンスがあれば、配置はそちらに IPC で頼む（設定やホットキーの状態を壊さないため）。
+// プロファイル名を省略すると、最後に使っていたプロファイル（レジストリの直下）を使う。
+//
+constexpr double STARTUP_BUDGET_MS = 50.0;  // プロセス生成から配置完了まで
+constexpr int DEFAULT_BENCH_COUNT = 20;
+
+// 終了コード
+enum ExitCode {
+  Ok = 0,
+  TargetNotFound = 1,
+  ProfileNotFound = 2,
+  ForwardFailed = 3,
+  OverBudget = 4,
+  BadArguments = 5,
+};
+
+// コマンドラインがヘッドレスモードの指定なら実行して終了コードを返す。そうでなければ空を返す
+std::optional<int> run(AM::Win32::StrPtr commandLine);
+
+} // namespace Umapita::Headless
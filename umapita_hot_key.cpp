@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_hot_key.h"
+#include "umapita_perf_counters.h"
+
+using namespace Umapita;
+using namespace AM;
+using Win32::Window;
+
+namespace {
+
+std::vector<Win32::tstring> split(const Win32::tstring &src, TCHAR delim) {
+  std::vector<Win32::tstring> ret;
+  Win32::tstring::size_type pos = 0;
+
+  for (;;) {
+    auto next = src.find(delim, pos);
+    auto token = Win32::remove_ws_on_both_ends(src.substr(pos, next == Win32::tstring::npos ? next : next - pos));
+    if (!token.empty())
+      ret.emplace_back(std::move(token));
+    if (next == Win32::tstring::npos)
+      break;
+    pos = next + 1;
+  }
+  return ret;
+}
+
+bool parse_long(const Win32::tstring &src, LONG &ret) {
+  if (src.empty())
+    return false;
+  TCHAR *end;
+  ret = _tcstol(src.c_str(), &end, 10);
+  return *end == TEXT('\0');
+}
+
+bool parse_chord(const Win32::tstring &src, HotKeyChord &ret) {
+  constexpr std::pair<LPCTSTR, UINT> MODIFIERS[] = {
+    {TEXT("Alt"), MOD_ALT}, {TEXT("Ctrl"), MOD_CONTROL}, {TEXT("Shift"), MOD_SHIFT}, {TEXT("Win"), MOD_WIN},
+  };
+  constexpr std::pair<LPCTSTR, UINT> KEYS[] = {
+    {TEXT("Left"), VK_LEFT}, {TEXT("Right"), VK_RIGHT}, {TEXT("Up"), VK_UP}, {TEXT("Down"), VK_DOWN},
+  };
+
+  auto tokens = split(src, TEXT('+'));
+  if (tokens.empty())
+    return false;
+
+  HotKeyChord chord;
+  for (std::size_t i=0; i<tokens.size()-1; i++) {
+    auto found = std::find_if(std::begin(MODIFIERS), std::end(MODIFIERS),
+                              [&tokens, i](auto const &m) { return !lstrcmpi(m.first, tokens[i].c_str()); });
+    if (found == std::end(MODIFIERS))
+      return false;
+    chord.modifiers |= found->second;
+  }
+
+  auto const &key = tokens.back();
+  if (key.size() == 1 && _istalnum(key[0])) {
+    chord.keycode = _totupper(key[0]);
+  } else if (LONG n; (key[0] == TEXT('F') || key[0] == TEXT('f')) && parse_long(key.substr(1), n) && n >= 1 && n <= 24) {
+    chord.keycode = VK_F1 + n - 1;
+  } else if (auto found = std::find_if(std::begin(KEYS), std::end(KEYS),
+                                       [&key](auto const &k) { return !lstrcmpi(k.first, key.c_str()); });
+             found != std::end(KEYS)) {
+    chord.keycode = found->second;
+  } else
+    return false;
+
+  ret = chord;
+  return true;
+}
+
+bool parse_action(const Win32::tstring &src, HotKeyAction &ret) {
+  auto colon = src.find(TEXT(':'));
+  auto verb = src.substr(0, colon);
+  auto arg = colon == Win32::tstring::npos ? Win32::tstring{} : src.substr(colon + 1);
+  HotKeyAction action;
+
+  if (!lstrcmpi(verb.c_str(), TEXT("select"))) {
+    LONG n;
+    if (!parse_long(arg, n) || n < 1)
+      return false;
+    action.kind = HotKeyAction::SelectByIndex;
+    action.arg0 = n - 1;
+  } else if (!lstrcmpi(verb.c_str(), TEXT("profile"))) {
+    if (arg.empty())
+      return false;
+    action.kind = HotKeyAction::SelectByName;
+    action.name = arg;
+  } else if (!lstrcmpi(verb.c_str(), TEXT("next"))) {
+    action.kind = HotKeyAction::Next;
+  } else if (!lstrcmpi(verb.c_str(), TEXT("prev"))) {
+    action.kind = HotKeyAction::Previous;
+  } else if (!lstrcmpi(verb.c_str(), TEXT("toggle"))) {
+    action.kind = HotKeyAction::ToggleEnabled;
+  } else if (!lstrcmpi(verb.c_str(), TEXT("nudge"))) {
+    auto xy = split(arg, TEXT(','));
+    if (xy.size() != 2 || !parse_long(xy[0], action.arg0) || !parse_long(xy[1], action.arg1))
+      return false;
+    action.kind = HotKeyAction::Nudge;
+  } else
+    return false;
+
+  ret = std::move(action);
+  return true;
+}
+
+} // namespace
+
+std::vector<HotKeyBinding> HotKeyTable::parse(Win32::StrPtr spec) {
+  std::vector<HotKeyBinding> ret;
+
+  if (!spec.ptr)
+    return ret;
+  for (auto const &entry : split(spec.ptr, TEXT(';'))) {
+    auto eq = entry.find(TEXT('='));
+    HotKeyBinding binding;
+    if (eq == Win32::tstring::npos ||
+        !parse_chord(entry.substr(0, eq), binding.chord) ||
+        !parse_action(Win32::remove_ws_on_both_ends(entry.substr(eq + 1)), binding.action)) {
+      Log::warning(TEXT("invalid hot key binding: \"%ls\""), entry.c_str());
+      continue;
+    }
+    ret.emplace_back(std::move(binding));
+  }
+  return ret;
+}
+
+void HotKeyTable::set_bindings(std::vector<HotKeyBinding> bindings) {
+  if (m_slots.size() < bindings.size())
+    m_slots.resize(bindings.size());
+  for (std::size_t i=0; i<m_slots.size(); i++) {
+    if (i < bindings.size()) {
+      m_slots[i].binding = std::move(bindings[i]);
+      m_slots[i].isActive = true;
+    } else
+      m_slots[i].isActive = false;
+  }
+}
+
+void HotKeyTable::arm(Window host, bool isFocusOn, bool isEnabled) {
+  auto const before = m_counters;
+
+  for (std::size_t i=0; i<m_slots.size(); i++) {
+    auto &slot = m_slots[i];
+    int id = i + HOT_KEY_ID_BASE;
+    auto isWanted = slot.isActive && isFocusOn && (isEnabled || slot.binding.action.kind == HotKeyAction::ToggleEnabled);
+
+    if (slot.isRegistered && (!isWanted || slot.registeredChord != slot.binding.chord)) {
+      UnregisterHotKey(host.get(), id);
+      m_counters.unregisterCalls++;
+      slot.isRegistered = false;
+    }
+    if (isWanted && !slot.isRegistered) {
+      auto const &chord = slot.binding.chord;
+      m_counters.registerCalls++;
+      if (RegisterHotKey(host.get(), id, chord.modifiers, chord.keycode)) {
+        slot.isRegistered = true;
+        slot.registeredChord = chord;
+      } else {
+        m_counters.registerFailures++;
+        Log::warning(TEXT("cannot set hot key: modifiers=%X, keycode=%X"), chord.modifiers, chord.keycode);
+      }
+    }
+  }
+
+  // 使われなくなった末尾のスロットを詰める
+  while (!m_slots.empty() && !m_slots.back().isActive && !m_slots.back().isRegistered)
+    m_slots.pop_back();
+
+  if (before.registerCalls != m_counters.registerCalls || before.unregisterCalls != m_counters.unregisterCalls)
+    Log::info(TEXT("hot keys armed: register=%lu (failed=%lu), unregister=%lu"),
+              m_counters.registerCalls, m_counters.registerFailures, m_counters.unregisterCalls);
+}
+
+void HotKeyTable::disarm_all(Window host) {
+  arm(host, false, false);
+}
+
+const HotKeyAction *HotKeyTable::find(WPARAM id) {
+  auto i = static_cast<std::size_t>(id - HOT_KEY_ID_BASE);
+  if (i >= m_slots.size() || !m_slots[i].isActive)
+    return nullptr;
+  m_counters.dispatches++;
+  Perf::bump(Perf::Counter::HotKeyDispatches);
+  return &m_slots[i].binding.action;
+}
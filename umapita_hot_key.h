@@ -0,0 +1,77 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// ホットキーの割り当て
+//
+// 設定文字列の書式は "<chord>=<action>;<chord>=<action>;..."
+//   chord  : Alt, Ctrl, Shift, Win を + でつないだ修飾キーとキー名 (0-9, A-Z, F1-F24, Left, Right, Up, Down)
+//   action : select:<n>      プロファイル一覧の n 番目 (1 から数える) を選ぶ
+//            profile:<name>  名前でプロファイルを選ぶ
+//            next, prev      一覧の次 / 前のプロファイルを選ぶ
+//            toggle          調整の有効 / 無効を切り替える
+//            nudge:<dx>,<dy> 現在の向きのオフセットをずらす
+//
+struct HotKeyChord {
+  UINT modifiers = 0;
+  UINT keycode = 0;
+};
+
+inline bool operator == (const HotKeyChord &lhs, const HotKeyChord &rhs) {
+  return lhs.modifiers == rhs.modifiers && lhs.keycode == rhs.keycode;
+}
+
+inline bool operator != (const HotKeyChord &lhs, const HotKeyChord &rhs) {
+  return !(lhs == rhs);
+}
+
+struct HotKeyAction {
+  enum Kind { SelectByIndex, SelectByName, Next, Previous, ToggleEnabled, Nudge } kind = SelectByIndex;
+  LONG arg0 = 0, arg1 = 0;  // SelectByIndex: arg0 = 0 から数えた番号, Nudge: arg0 = dx, arg1 = dy
+  AM::Win32::tstring name;  // SelectByName
+};
+
+struct HotKeyBinding {
+  HotKeyChord chord;
+  HotKeyAction action;
+};
+
+//
+// ホットキーのテーブル
+//
+// ホットキー ID = HOT_KEY_ID_BASE + テーブル上の位置なので、ディスパッチは O(1)。
+// OS への登録状態をスロットごとに覚えておき、arm() では望ましい状態との差分だけを
+// RegisterHotKey / UnregisterHotKey する。
+//
+class HotKeyTable {
+public:
+  struct Counters {
+    unsigned long registerCalls = 0;
+    unsigned long registerFailures = 0;
+    unsigned long unregisterCalls = 0;
+    unsigned long dispatches = 0;
+  };
+
+private:
+  struct Slot {
+    HotKeyBinding binding;
+    bool isActive = false;      // 現在のテーブルに含まれているか
+    bool isRegistered = false;  // OS に登録済みか
+    HotKeyChord registeredChord;
+  };
+  std::vector<Slot> m_slots;
+  Counters m_counters;
+
+public:
+  static std::vector<HotKeyBinding> parse(AM::Win32::StrPtr spec);
+  // OS への登録は次の arm() まで遅延される
+  void set_bindings(std::vector<HotKeyBinding> bindings);
+  // フォーカスがターゲットにあればホットキーを有効にする。調整が無効な間は toggle だけを有効にする
+  void arm(AM::Win32::Window host, bool isFocusOn, bool isEnabled);
+  void disarm_all(AM::Win32::Window host);
+  const HotKeyAction *find(WPARAM id);
+  const Counters &counters() const { return m_counters; }
+};
+
+} // namespace Umapita
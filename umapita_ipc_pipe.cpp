@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_ipc_transport.h"
+
+using namespace AM;
+using namespace Umapita::Ipc;
+
+namespace {
+
+constexpr DWORD PIPE_BUFFER_SIZE = 4096;
+
+// SYSTEM, Administrators, 所有者はフルアクセス、対話ユーザは読み書きできる。
+// 昇格して動いているので、整合性レベルを Medium にしておかないと普通のスクリプトから書き込めない。
+constexpr TCHAR PIPE_SDDL[] = TEXT("D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;GRGW;;;IU)S:(ML;;NW;;;ME)");
+
+// 重複 I/O の完了か停止イベントを待つ。完了したら転送バイト数を返す
+bool wait_overlapped(HANDLE hPipe, OVERLAPPED &ov, HANDLE hStopEvent, DWORD timeout, DWORD &transferred) {
+  HANDLE handles[] = { ov.hEvent, hStopEvent };
+  auto ret = WaitForMultipleObjects(std::size(handles), handles, false, timeout);
+  if (ret != WAIT_OBJECT_0) {
+    CancelIo(hPipe);
+    GetOverlappedResult(hPipe, &ov, &transferred, true);
+    return false;
+  }
+  return GetOverlappedResult(hPipe, &ov, &transferred, false);
+}
+
+class NamedPipeConnection : public Connection {
+  HANDLE m_hPipe;
+  HANDLE m_hEvent;
+  HANDLE m_hStopEvent;
+
+  template <typename Fn>
+  bool transfer(std::size_t len, Fn fn) {
+    std::size_t done = 0;
+    while (done < len) {
+      OVERLAPPED ov{};
+      ov.hEvent = m_hEvent;
+      DWORD transferred = 0;
+      if (!fn(done, len - done, &transferred, &ov)) {
+        if (GetLastError() != ERROR_IO_PENDING)
+          return false;
+        if (!wait_overlapped(m_hPipe, ov, m_hStopEvent, static_cast<DWORD>(IO_TIMEOUT.count()), transferred))
+          return false;
+      } else if (!GetOverlappedResult(m_hPipe, &ov, &transferred, false))
+        return false;
+      if (!transferred)
+        return false;
+      done += transferred;
+    }
+    return true;
+  }
+
+  // クライアントが閉じる (ERROR_BROKEN_PIPE) まで読み捨てる。
+  // FlushFileBuffers() は読まないクライアントをいつまでも待つので使わない
+  void wait_for_client_close() {
+    auto deadline = GetTickCount64() + IO_TIMEOUT.count();
+    std::uint8_t scratch[64];
+    for (auto now = GetTickCount64(); now < deadline; now = GetTickCount64()) {
+      OVERLAPPED ov{};
+      ov.hEvent = m_hEvent;
+      DWORD transferred = 0;
+      if (!ReadFile(m_hPipe, scratch, sizeof (scratch), &transferred, &ov)) {
+        if (GetLastError() != ERROR_IO_PENDING)
+          return;
+        if (!wait_overlapped(m_hPipe, ov, m_hStopEvent, static_cast<DWORD>(deadline - now), transferred))
+          return;
+      } else if (!GetOverlappedResult(m_hPipe, &ov, &transferred, false))
+        return;
+    }
+  }
+
+public:
+  NamedPipeConnection(HANDLE hPipe, HANDLE hStopEvent)
+    : m_hPipe{hPipe}, m_hEvent{CreateEvent(nullptr, true, false, nullptr)}, m_hStopEvent{hStopEvent} { }
+  ~NamedPipeConnection() override {
+    // クライアントがまだ読んでいない応答（不正なリクエストへの BadRequest など）を捨てないように待つ
+    wait_for_client_close();
+    DisconnectNamedPipe(m_hPipe);
+    CloseHandle(m_hPipe);
+    CloseHandle(m_hEvent);
+  }
+  bool read(void *buf, std::size_t len) override {
+    auto p = static_cast<std::uint8_t *>(buf);
+    return transfer(len, [this, p](std::size_t offset, std::size_t remain, DWORD *transferred, OVERLAPPED *ov) {
+                           return ReadFile(m_hPipe, p + offset, remain, transferred, ov);
+                         });
+  }
+  bool write(const void *buf, std::size_t len) override {
+    auto p = static_cast<const std::uint8_t *>(buf);
+    return transfer(len, [this, p](std::size_t offset, std::size_t remain, DWORD *transferred, OVERLAPPED *ov) {
+                           return WriteFile(m_hPipe, p + offset, remain, transferred, ov);
+                         });
+  }
+};
+
+class NamedPipeTransport : public Transport {
+  Win32::tstring m_name;
+  HANDLE m_hStopEvent;
+  PSECURITY_DESCRIPTOR m_pSecurityDescriptor = nullptr;
+
+public:
+  explicit NamedPipeTransport(Win32::StrPtr name)
+    : m_name{name.ptr}, m_hStopEvent{CreateEvent(nullptr, true, false, nullptr)} {
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptor(PIPE_SDDL, SDDL_REVISION_1, &m_pSecurityDescriptor, nullptr)) {
+      Log::warning(TEXT("cannot create security descriptor for the pipe: %lu"), GetLastError());
+      m_pSecurityDescriptor = nullptr;
+    }
+  }
+  ~NamedPipeTransport() override {
+    if (m_pSecurityDescriptor)
+      LocalFree(m_pSecurityDescriptor);
+    CloseHandle(m_hStopEvent);
+  }
+  std::unique_ptr<Connection> accept() override {
+    SECURITY_ATTRIBUTES sa{};
+    sa.nLength = sizeof (sa);
+    sa.lpSecurityDescriptor = m_pSecurityDescriptor;
+    sa.bInheritHandle = false;
+
+    auto hPipe = CreateNamedPipe(m_name.c_str(),
+                                 PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                 PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                 1, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0,
+                                 m_pSecurityDescriptor ? &sa : nullptr);
+    if (hPipe == INVALID_HANDLE_VALUE) {
+      Log::error(TEXT("cannot create pipe \"%ls\": %lu"), m_name.c_str(), GetLastError());
+      return nullptr;
+    }
+
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEvent(nullptr, true, false, nullptr);
+    auto isConnected = ConnectNamedPipe(hPipe, &ov);
+    if (!isConnected) {
+      switch (GetLastError()) {
+      case ERROR_PIPE_CONNECTED:
+        isConnected = true;
+        break;
+      case ERROR_IO_PENDING: {
+        DWORD dummy;
+        isConnected = wait_overlapped(hPipe, ov, m_hStopEvent, INFINITE, dummy);
+        break;
+      }
+      }
+    }
+    CloseHandle(ov.hEvent);
+    if (!isConnected) {
+      CloseHandle(hPipe);
+      return nullptr;
+    }
+    return std::make_unique<NamedPipeConnection>(hPipe, m_hStopEvent);
+  }
+  void shutdown() override {
+    SetEvent(m_hStopEvent);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<Transport> Umapita::Ipc::make_named_pipe_transport(Win32::StrPtr name) {
+  return std::make_unique<NamedPipeTransport>(name);
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+//
+// 外部ツールからの制御用のバイナリプロトコル
+//
+// トランスポートに依存しないように標準ライブラリだけで書いてある。
+// 数値はすべてリトルエンディアン。文字列は UTF-16 のコード単位列で、長さ (u16) を前置する。
+//
+// リクエスト : magic(u32) version(u16) opcode(u16) length(u32) payload[length]
+// レスポンス : magic(u32) version(u16) status(u16) length(u32) payload[length]
+//
+// opcode:
+//   SwitchProfile : payload = name(str)          → status のみ
+//   ApplyNow      : payload なし                 → status のみ
+//   GetStatus     : payload なし                 → Status を encode_status() したもの
+//   GetMetrics    : payload なし                 → count(u32) value(u64)[count]（並びは Metrics のメンバ順）
+//
+namespace Umapita::Ipc {
+
+constexpr std::uint32_t MAGIC = 0x54504D55; // "UMPT"
+constexpr std::uint16_t VERSION = 1;
+constexpr std::size_t HEADER_SIZE = 12;
+constexpr std::uint32_t MAX_PAYLOAD_SIZE = 1024;
+
+enum class Opcode : std::uint16_t { SwitchProfile = 1, ApplyNow = 2, GetStatus = 3, GetMetrics = 4 };
+enum class StatusCode : std::uint16_t { Ok = 0, Accepted = 1, BadRequest = 2, UnknownOpcode = 3, NotFound = 4 };
+
+struct Header {
+  std::uint32_t magic = MAGIC;
+  std::uint16_t version = VERSION;
+  std::uint16_t code = 0;  // リクエストなら Opcode、レスポンスなら StatusCode
+  std::uint32_t length = 0;
+};
+
+struct Status {
+  bool hasTarget = false;
+  bool isEnabled = false;
+  bool isFocusOn = false;
+  bool isHorizontal = false;
+  std::int32_t windowRect[4] = {0, 0, 0, 0};  // left, top, right, bottom
+  std::int32_t clientRect[4] = {0, 0, 0, 0};
+  std::u16string profileName;
+};
+
+struct Metrics {
+  std::uint64_t ticks = 0;
+  std::uint64_t statusChanges = 0;
+  std::uint64_t hotKeyRegisterCalls = 0;
+  std::uint64_t hotKeyUnregisterCalls = 0;
+  std::uint64_t hotKeyRegisterFailures = 0;
+  std::uint64_t hotKeyDispatches = 0;
+  std::uint64_t ipcRequests = 0;
+};
+
+using Buffer = std::vector<std::uint8_t>;
+
+//
+// エンコーダ
+//
+class Writer {
+  Buffer &m_buf;
+public:
+  explicit Writer(Buffer &buf) : m_buf{buf} { }
+  void u8(std::uint8_t v) { m_buf.push_back(v); }
+  void u16(std::uint16_t v) { u8(v & 0xFF); u8(v >> 8); }
+  void u32(std::uint32_t v) { u16(v & 0xFFFF); u16(v >> 16); }
+  void u64(std::uint64_t v) { u32(v & 0xFFFFFFFF); u32(v >> 32); }
+  void i32(std::int32_t v) { u32(static_cast<std::uint32_t>(v)); }
+  void str(const std::u16string &s) {
+    u16(static_cast<std::uint16_t>(s.size()));
+    for (auto c : s)
+      u16(c);
+  }
+};
+
+//
+// デコーダ
+// 範囲外を読もうとすると以降は常に失敗し、ok() が false になる
+//
+class Reader {
+  const std::uint8_t *m_ptr;
+  std::size_t m_remain;
+  bool m_isOk = true;
+  bool take(std::size_t n) {
+    if (!m_isOk || m_remain < n)
+      return m_isOk = false;
+    return true;
+  }
+public:
+  Reader(const std::uint8_t *ptr, std::size_t len) : m_ptr{ptr}, m_remain{len} { }
+  explicit Reader(const Buffer &buf) : Reader{buf.data(), buf.size()} { }
+  bool ok() const { return m_isOk; }
+  bool eof() const { return m_remain == 0; }
+  std::uint8_t u8() {
+    if (!take(1))
+      return 0;
+    m_remain--;
+    return *m_ptr++;
+  }
+  std::uint16_t u16() { auto lo = u8(); return lo | (u8() << 8); }
+  std::uint32_t u32() { std::uint32_t lo = u16(); return lo | (static_cast<std::uint32_t>(u16()) << 16); }
+  std::uint64_t u64() { std::uint64_t lo = u32(); return lo | (static_cast<std::uint64_t>(u32()) << 32); }
+  std::int32_t i32() { return static_cast<std::int32_t>(u32()); }
+  std::u16string str() {
+    std::u16string s;
+    auto len = u16();
+    if (!take(len * 2))
+      return s;
+    s.reserve(len);
+    for (auto i=0; i<len; i++)
+      s += static_cast<char16_t>(u16());
+    return s;
+  }
+};
+
+inline Buffer encode_header(const Header &h) {
+  Buffer buf;
+  Writer w{buf};
+  w.u32(h.magic);
+  w.u16(h.version);
+  w.u16(h.code);
+  w.u32(h.length);
+  return buf;
+}
+
+// ヘッダを読む。マジック・バージョン・長さが不正なら false
+inline bool decode_header(const std::uint8_t (&raw)[HEADER_SIZE], Header &h) {
+  Reader r{raw, HEADER_SIZE};
+  h.magic = r.u32();
+  h.version = r.u16();
+  h.code = r.u16();
+  h.length = r.u32();
+  return r.ok() && h.magic == MAGIC && h.version == VERSION && h.length <= MAX_PAYLOAD_SIZE;
+}
+
+inline Buffer encode_message(std::uint16_t code, const Buffer &payload) {
+  auto buf = encode_header(Header{MAGIC, VERSION, code, static_cast<std::uint32_t>(payload.size())});
+  buf.insert(buf.end(), payload.begin(), payload.end());
+  return buf;
+}
+
+inline Buffer encode_status(const Status &s) {
+  Buffer buf;
+  Writer w{buf};
+  w.u8(s.hasTarget);
+  w.u8(s.isEnabled);
+  w.u8(s.isFocusOn);
+  w.u8(s.isHorizontal);
+  for (auto v : s.windowRect)
+    w.i32(v);
+  for (auto v : s.clientRect)
+    w.i32(v);
+  w.str(s.profileName);
+  return buf;
+}
+
+inline bool decode_status(const Buffer &buf, Status &s) {
+  Reader r{buf};
+  s.hasTarget = r.u8();
+  s.isEnabled = r.u8();
+  s.isFocusOn = r.u8();
+  s.isHorizontal = r.u8();
+  for (auto &v : s.windowRect)
+    v = r.i32();
+  for (auto &v : s.clientRect)
+    v = r.i32();
+  s.profileName = r.str();
+  return r.ok() && r.eof();
+}
+
+inline Buffer encode_metrics(const Metrics &m) {
+  const std::uint64_t values[] = {
+    m.ticks, m.statusChanges,
+    m.hotKeyRegisterCalls, m.hotKeyUnregisterCalls, m.hotKeyRegisterFailures, m.hotKeyDispatches,
+    m.ipcRequests,
+  };
+  Buffer buf;
+  Writer w{buf};
+  w.u32(std::size(values));
+  for (auto v : values)
+    w.u64(v);
+  return buf;
+}
+
+// 知らない末尾のカウンタは読み飛ばし、足りないものは 0 のままにする
+inline bool decode_metrics(const Buffer &buf, Metrics &m) {
+  std::uint64_t *const values[] = {
+    &m.ticks, &m.statusChanges,
+    &m.hotKeyRegisterCalls, &m.hotKeyUnregisterCalls, &m.hotKeyRegisterFailures, &m.hotKeyDispatches,
+    &m.ipcRequests,
+  };
+  Reader r{buf};
+  auto count = r.u32();
+  if (!r.ok() || buf.size() - 4 != std::size_t{count} * 8)
+    return false;
+  m = Metrics{};
+  for (std::uint32_t i=0; i<count; i++) {
+    auto v = r.u64();
+    if (i < std::size(values))
+      *values[i] = v;
+  }
+  return r.ok() && r.eof();
+}
+
+} // namespace Umapita::Ipc
@@ -0,0 +1,169 @@
+#pragma once
+
+namespace Umapita::Ipc {
+
+//
+// 外部ツールからの制御を受け付けるサーバ
+//
+// 通信とデコードは専用のスレッドで行う。
+// get-status / get-metrics は UI スレッドが publish() した最新の値をそのまま返すので、UI スレッドを待たない。
+// switch-profile / apply-now はキューに積んで Handler::notify で知らせ、Accepted を返す。
+//
+// OS に依存するもの（通信路・ログ・UI スレッドへの通知・プロファイルの有無）は Transport と Handler から受け取るので、
+// 標準ライブラリだけで動く。
+//
+class Server {
+public:
+  struct Command {
+    enum Kind { SwitchProfile, ApplyNow } kind;
+    std::u16string profileName;
+  };
+
+  enum class LogLevel { Info, Warning };
+
+  // どれもサーバのスレッドから呼ばれる
+  struct Handler {
+    // コマンドを積んだ（host に WM_IPC_COMMAND をポストするなど）
+    std::function<void ()> notify;
+    std::function<bool (const std::u16string &name)> is_profile_existing;
+    std::function<void (LogLevel level, const char *message)> log;
+  };
+
+  // トランスポートが一時的に使えないときに再試行するまでの時間
+  static constexpr std::chrono::milliseconds RETRY_INTERVAL{1000};
+
+private:
+  std::unique_ptr<Transport> m_transport;
+  Handler m_handler;
+  std::mutex m_mutex;
+  std::condition_variable m_stopCond;
+  Status m_status;
+  Metrics m_metrics;
+  std::deque<Command> m_commands;
+  std::atomic<bool> m_isStopping{false};
+  std::atomic<std::uint64_t> m_requests{0};
+  std::thread m_thread;
+
+  void log(LogLevel level, const char *message) {
+    if (m_handler.log)
+      m_handler.log(level, message);
+  }
+
+  void run() {
+    log(LogLevel::Info, "IPC server started");
+    while (!m_isStopping) {
+      auto conn = m_transport->accept();
+      if (!conn) {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_stopCond.wait_for(lock, RETRY_INTERVAL, [this] { return m_isStopping.load(); });
+        continue;
+      }
+      // クライアントが切断するまで続けてリクエストを処理する
+      while (!m_isStopping && serve_one(*conn))
+        ;
+    }
+    log(LogLevel::Info, "IPC server stopped");
+  }
+
+  bool serve_one(Connection &conn) {
+    std::uint8_t raw[HEADER_SIZE];
+    Header header;
+    if (!conn.read(raw, sizeof (raw)))
+      return false;
+    if (!decode_header(raw, header)) {
+      log(LogLevel::Warning, "IPC: invalid request header");
+      auto response = encode_message(static_cast<std::uint16_t>(StatusCode::BadRequest), Buffer{});
+      conn.write(response.data(), response.size());
+      return false;
+    }
+    Buffer payload(header.length);
+    if (header.length && !conn.read(payload.data(), payload.size()))
+      return false;
+
+    m_requests++;
+    auto status = StatusCode::Ok;
+    auto body = handle(static_cast<Opcode>(header.code), payload, status);
+    auto response = encode_message(static_cast<std::uint16_t>(status), body);
+    return conn.write(response.data(), response.size());
+  }
+
+  Buffer handle(Opcode opcode, const Buffer &payload, StatusCode &status) {
+    switch (opcode) {
+    case Opcode::SwitchProfile: {
+      Reader r{payload};
+      auto name = r.str();
+      if (!r.ok() || !r.eof() || name.empty()) {
+        status = StatusCode::BadRequest;
+        return {};
+      }
+      if (!m_handler.is_profile_existing || !m_handler.is_profile_existing(name)) {
+        status = StatusCode::NotFound;
+        return {};
+      }
+      push_command(Command{Command::SwitchProfile, std::move(name)});
+      status = StatusCode::Accepted;
+      return {};
+    }
+    case Opcode::ApplyNow:
+      push_command(Command{Command::ApplyNow, {}});
+      status = StatusCode::Accepted;
+      return {};
+    case Opcode::GetStatus: {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      return encode_status(m_status);
+    }
+    case Opcode::GetMetrics: {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      auto metrics = m_metrics;
+      metrics.ipcRequests = m_requests;
+      return encode_metrics(metrics);
+    }
+    }
+    status = StatusCode::UnknownOpcode;
+    return {};
+  }
+
+  void push_command(Command command) {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_commands.emplace_back(std::move(command));
+    }
+    if (m_handler.notify)
+      m_handler.notify();
+  }
+
+public:
+  Server(std::unique_ptr<Transport> transport, Handler handler)
+    : m_transport{std::move(transport)}, m_handler{std::move(handler)} {
+    m_thread = std::thread{[this] { run(); }};
+  }
+  ~Server() {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_isStopping = true;
+    }
+    m_stopCond.notify_all();
+    m_transport->shutdown();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+  Server(const Server &) = delete;
+  Server &operator = (const Server &) = delete;
+
+  // UI スレッドから呼ぶ
+  void publish(const Status &status, const Metrics &metrics) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_status = status;
+    m_metrics = metrics;
+  }
+  bool pop_command(Command &command) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_commands.empty())
+      return false;
+    command = std::move(m_commands.front());
+    m_commands.pop_front();
+    return true;
+  }
+};
+
+} // namespace Umapita::Ipc
@@ -0,0 +1,35 @@
+#pragma once
+
+namespace Umapita::Ipc {
+
+// 一回の読み書きや、閉じるときにクライアントの切断を待つ最大時間
+constexpr std::chrono::milliseconds IO_TIMEOUT{1000};
+
+//
+// IPC のトランスポート
+//
+// Server はこのインターフェースだけを使うので、名前付きパイプ以外のもの
+// （テストやベンチマーク用の Unix ドメインソケットなど）に差し替えられる
+//
+class Connection {
+public:
+  // クライアントがまだ読んでいない応答を捨てないように、クライアントが切断するまで待ってから閉じる。
+  // 待つのは IO_TIMEOUT までで、Transport::shutdown() されたらすぐにやめること
+  virtual ~Connection() = default;
+  // len バイトちょうどを読み書きする。途中で切断されたりタイムアウトしたら false
+  virtual bool read(void *buf, std::size_t len) = 0;
+  virtual bool write(const void *buf, std::size_t len) = 0;
+};
+
+class Transport {
+public:
+  virtual ~Transport() = default;
+  // 次の接続を待つ。shutdown() されたら nullptr を返す
+  virtual std::unique_ptr<Connection> accept() = 0;
+  // accept() や読み書きを中断させる。別のスレッドから呼んでよい
+  virtual void shutdown() = 0;
+};
+
+std::unique_ptr<Transport> make_named_pipe_transport(AM::Win32::StrPtr name);
+
+} // namespace Umapita::Ipc
@@ -0,0 +1,168 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// モニタ矩形の空間インデックス
+//
+// 全モニタの左右端・上下端の座標で仮想デスクトップを格子に切り、各セルを覆っているモニタを（重なっていれば全部）持っておく。
+// 点の検索は二分探索二回で済み、矩形の検索はその矩形にかかるセルのモニタだけを見ればよい。
+// ミラーリングなどでモニタが重なっていても、線形探索と同じ答え（同じ条件なら番号の若い方）を返す。
+// ただし格子を引く手間があるので、モニタが少ないうちは全部を順に見た方が速い（tests/bench_monitor_index で 32 枚前後が分かれ目）。
+// linearScanLimit 枚以下なら格子は作らずに線形探索する。
+// モニタ構成が変わったら作り直すこと（UmapitaMonitors と同じ寿命）。
+//
+class MonitorIndex {
+public:
+  static constexpr std::size_t LINEAR_SCAN_LIMIT = 32;
+
+private:
+  std::vector<LONG> m_xs, m_ys;          // ソート済み・重複なし。線形探索するときは空
+  std::vector<std::size_t> m_cellStarts;  // セル i を覆うモニタは m_cellMonitors[m_cellStarts[i]] から m_cellMonitors[m_cellStarts[i+1]] の手前まで
+  std::vector<int> m_cellMonitors;        // セルごとに番号の若い順
+  std::vector<RECT> m_rects;
+
+  // edges[i] <= v < edges[i+1] となる i。範囲外なら -1
+  static int bucket(const std::vector<LONG> &edges, LONG v) {
+    auto i = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), v) - edges.begin()) - 1;
+    return i < 0 || i+1 >= static_cast<int>(edges.size()) ? -1 : i;
+  }
+  // [lo, hi) にかかるセルの範囲 [first, last)
+  static std::pair<int, int> bucket_range(const std::vector<LONG> &edges, LONG lo, LONG hi) {
+    auto first = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), lo) - edges.begin()) - 1;
+    auto last = static_cast<int>(std::lower_bound(edges.begin(), edges.end(), hi) - edges.begin());
+    return {std::max(first, 0), std::min(last, static_cast<int>(edges.size()) - 1)};
+  }
+  int columns() const { return static_cast<int>(m_xs.size()) - 1; }
+  // セルを覆うモニタの範囲 [first, last)
+  std::pair<const int *, const int *> cell(int ix, int iy) const {
+    auto i = iy*columns() + ix;
+    return {m_cellMonitors.data() + m_cellStarts[i], m_cellMonitors.data() + m_cellStarts[i+1]};
+  }
+  bool is_linear() const { return m_cellStarts.empty(); }
+  // rc にかかるセルごとに fn(セルの番号) を呼ぶ
+  template <typename Fn>
+  void for_each_cell(const RECT &rc, Fn fn) const {
+    auto [x0, x1] = bucket_range(m_xs, rc.left, rc.right);
+    auto [y0, y1] = bucket_range(m_ys, rc.top, rc.bottom);
+    for (auto iy=y0; iy<y1; iy++)
+      for (auto ix=x0; ix<x1; ix++)
+        fn(iy*columns() + ix);
+  }
+
+  static bool contains(const RECT &m, const RECT &rc) {
+    return m.left <= rc.left && m.top <= rc.top && rc.right <= m.right && rc.bottom <= m.bottom;
+  }
+  static LONGLONG overlap(const RECT &m, const RECT &rc) {
+    LONGLONG w = std::min(m.right, rc.right) - std::max(m.left, rc.left);
+    LONGLONG h = std::min(m.bottom, rc.bottom) - std::max(m.top, rc.top);
+    return w > 0 && h > 0 ? w*h : 0;
+  }
+
+public:
+  MonitorIndex() = default;
+  explicit MonitorIndex(const std::vector<RECT> &rects, std::size_t linearScanLimit = LINEAR_SCAN_LIMIT) : m_rects{rects} {
+    if (rects.size() <= linearScanLimit)
+      return;
+    for (auto const &rc : rects) {
+      m_xs.push_back(rc.left);
+      m_xs.push_back(rc.right);
+      m_ys.push_back(rc.top);
+      m_ys.push_back(rc.bottom);
+    }
+    for (auto *v : {&m_xs, &m_ys}) {
+      std::sort(v->begin(), v->end());
+      v->erase(std::unique(v->begin(), v->end()), v->end());
+    }
+    if (m_xs.size() < 2 || m_ys.size() < 2) {
+      m_xs.clear();
+      m_ys.clear();
+      return;
+    }
+    // セルごとの数を数えてから番号の順に詰める
+    auto numCells = columns() * (m_ys.size()-1);
+    m_cellStarts.assign(numCells + 1, 0);
+    for (auto const &rc : rects)
+      for_each_cell(rc, [this](std::size_t i) { m_cellStarts[i+1]++; });
+    std::partial_sum(m_cellStarts.begin(), m_cellStarts.end(), m_cellStarts.begin());
+    m_cellMonitors.resize(m_cellStarts.back());
+    std::vector<std::size_t> filled(m_cellStarts.begin(), m_cellStarts.end() - 1);
+    for (int n=0; n<static_cast<int>(rects.size()); n++)
+      for_each_cell(rects[n], [this, &filled, n](std::size_t i) { m_cellMonitors[filled[i]++] = n; });
+  }
+
+  // pt を含むモニタの番号。どのモニタにも含まれなければ -1
+  int find_by_point(POINT pt) const {
+    if (is_linear()) {
+      for (int n=0; n<static_cast<int>(m_rects.size()); n++) {
+        auto const &m = m_rects[n];
+        if (m.left <= pt.x && pt.x < m.right && m.top <= pt.y && pt.y < m.bottom)
+          return n;
+      }
+      return -1;
+    }
+    auto ix = bucket(m_xs, pt.x);
+    auto iy = bucket(m_ys, pt.y);
+    if (ix < 0 || iy < 0)
+      return -1;
+    auto [first, last] = cell(ix, iy);
+    return first != last ? *first : -1;
+  }
+
+  // rc を完全に含むモニタの番号。なければ -1
+  int find_by_containment(const RECT &rc) const {
+    if (rc.right <= rc.left || rc.bottom <= rc.top)
+      return -1;
+    if (is_linear()) {
+      for (int n=0; n<static_cast<int>(m_rects.size()); n++)
+        if (contains(m_rects[n], rc))
+          return n;
+      return -1;
+    }
+    // rc を含むモニタは rc の左上のセルを必ず覆っている
+    auto ix = bucket(m_xs, rc.left);
+    auto iy = bucket(m_ys, rc.top);
+    if (ix < 0 || iy < 0)
+      return -1;
+    auto [first, last] = cell(ix, iy);
+    auto it = std::find_if(first, last, [this, &rc](int n) { return contains(m_rects[n], rc); });
+    return it != last ? *it : -1;
+  }
+
+  // rc と一番広く重なっているモニタの番号。どれとも重ならなければ -1
+  // 面積が同じなら番号の若い方を返す（MonitorFromRect と同じ考え方）
+  int find_by_largest_overlap(const RECT &rc) const {
+    if (rc.right <= rc.left || rc.bottom <= rc.top)
+      return -1;
+    if (is_linear()) {
+      auto best = -1;
+      LONGLONG bestArea = 0;
+      for (int n=0; n<static_cast<int>(m_rects.size()); n++) {
+        if (auto area = overlap(m_rects[n], rc); area > bestArea) {
+          best = n;
+          bestArea = area;
+        }
+      }
+      return best;
+    }
+    // rc にかかるセルを覆うモニタだけを候補にして、重なりの面積はモニタの矩形から直接求める。
+    // 一つのウィンドウがかかるモニタはせいぜい数枚なので、線形リストで十分
+    std::vector<int> candidates;
+    for_each_cell(rc, [this, &candidates](std::size_t i) {
+                        for (auto k=m_cellStarts[i]; k<m_cellStarts[i+1]; k++)
+                          if (std::find(candidates.begin(), candidates.end(), m_cellMonitors[k]) == candidates.end())
+                            candidates.push_back(m_cellMonitors[k]);
+                      });
+    auto best = -1;
+    LONGLONG bestArea = 0;
+    for (auto n : candidates) {
+      if (auto area = overlap(m_rects[n], rc); area > bestArea || (area == bestArea && area > 0 && n < best)) {
+        best = n;
+        bestArea = area;
+      }
+    }
+    return best;
+  }
+};
+
+} // namespace Umapita
@@ -8,11 +8,28 @@ struct UmapitaMonitors {
     AM::Win32::tstring name;
     RECT whole;
     RECT work;
-    Monitor(LPCTSTR aName, RECT aWhole, RECT aWork) : name{aName}, whole{aWhole}, work{aWork} { }
+    AM::Win32::tstring id;  // デバイスインターフェース名。\\.\DISPLAYn と違って抜き差しや再起動で変わらない
+    Monitor(LPCTSTR aName, RECT aWhole, RECT aWork, LPCTSTR aId = TEXT(""))
+      : name{aName}, whole{aWhole}, work{aWork}, id{aId} { }
   };
 
 private:
+  // 物理モニタは 2 番目から（-1: 仮想デスクトップ全体, 0: プライマリ）
+  static constexpr std::size_t PHYSICAL_BASE = 2;
   std::vector<Monitor> m_monitors;
+  Umapita::MonitorIndex m_index;  // 物理モニタの whole の空間インデックス
+  std::unordered_map<AM::Win32::tstring, std::size_t> m_names;
+
+  const Monitor *get_physical_monitor(int n) const {
+    return n < 0 ? nullptr : &m_monitors[PHYSICAL_BASE + n];
+  }
+
+  static AM::Win32::tstring get_device_id(LPCTSTR device) {
+    auto dd = AM::Win32::make_sized_pod<DISPLAY_DEVICE>();
+    if (!EnumDisplayDevices(device, 0, &dd, EDD_GET_DEVICE_INTERFACE_NAME))
+      return {};
+    return dd.DeviceID;
+  }
 
 public:
   UmapitaMonitors() {
@@ -50,7 +67,17 @@ public:
     }
     // 1-: physical monitors
     for (auto &mi : mis)
-      m_monitors.emplace_back(mi.szDevice, mi.rcMonitor, mi.rcWork);
+      m_monitors.emplace_back(mi.szDevice, mi.rcMonitor, mi.rcWork, get_device_id(mi.szDevice).c_str());
+
+    std::vector<RECT> rects;
+    for (auto i=PHYSICAL_BASE; i<m_monitors.size(); i++) {
+      auto const &m = m_monitors[i];
+      rects.push_back(m.whole);
+      m_names.emplace(m.name, i);
+      if (!m.id.empty())
+        m_names.emplace(m.id, i);
+    }
+    m_index = Umapita::MonitorIndex{rects};
   }
   const Monitor *get_monitor_by_number(int monitorNumber) const {
     auto mn = monitorNumber + 1;
@@ -60,6 +87,24 @@ public:
 
     return &m_monitors[mn];
   }
+  // pt を含む物理モニタ
+  const Monitor *get_monitor_by_point(POINT pt) const {
+    return get_physical_monitor(m_index.find_by_point(pt));
+  }
+  // rc を完全に含む物理モニタ
+  const Monitor *get_monitor_by_containment(const RECT &rc) const {
+    return get_physical_monitor(m_index.find_by_containment(rc));
+  }
+  // rc と一番広く重なっている物理モニタ
+  const Monitor *get_monitor_by_rect(const RECT &rc) const {
+    return get_physical_monitor(m_index.find_by_largest_overlap(rc));
+  }
+  // デバイスインターフェース名か \\.\DISPLAYn で物理モニタを探す
+  const Monitor *get_monitor_by_name(AM::Win32::StrPtr name) const {
+    if (auto it = m_names.find(name.ptr); it != m_names.end())
+      return &m_monitors[it->second];
+    return nullptr;
+  }
   template <typename Fn>
   void enum_monitors(Fn fn) {
     int index = -1;
@@ -0,0 +1,140 @@
+#pragma once
+
+//
+// 外部から観測するための性能カウンタ
+//
+// カウンタは UI スレッドだけが local_counters() に数え、tick ごとに共有メモリの Block に publish() する。
+// Block はトランスポートに依存しないように標準ライブラリだけで書いてあり、読み手は read() を使う（seqlock）。
+//
+//   書き手 : sequence を奇数にする → values を書く → sequence を偶数にする
+//   読み手 : sequence が偶数になるまで待つ → values を読む → sequence が変わっていなければ成功
+//
+// 後ろにカウンタを増やしても古い読み手が読めるように、numCounters 個より後ろは読まないこと。
+// 並びを変えたり途中に挿入したりする場合は VERSION を上げる。
+//
+namespace Umapita::Perf {
+
+constexpr std::uint32_t MAGIC = 0x43504D55; // "UMPC"
+constexpr std::uint32_t VERSION = 1;
+constexpr std::size_t MAX_COUNTERS = 32;
+
+enum class Counter : std::uint32_t {
+  Ticks,                     // タイマの tick
+  TargetLookups,             // ターゲットウィンドウの検索
+  TargetCacheHits,           // 検索したが前回と状態が変わっていなかった
+  Adjusts,                   // TargetStatus::adjust, Tiling::apply の呼び出し
+  SetWindowPosAttempts,
+  SetWindowPosFailures,
+  AccessDeniedSuppressions,  // ERROR_ACCESS_DENIED のため次回の再試行を抑止した
+  MonitorResets,
+  ProfileLoads,
+  ProfileSaves,
+  HotKeyDispatches,
+  ConvergenceSettles,        // 理想の矩形に届かない位置で確定した
+  ConvergenceBackoffs,       // 配置の取り合いになったので一時停止した
+  ConvergenceSuppressions,   // 上の二つの状態のため SetWindowPos を呼ばなかった
+  MoveSizeSuppressions,      // ユーザがドラッグ・リサイズしている間のため配置しなかった
+  TargetAbsentMillis,        // ターゲットの状態ごとの累積時間 (ms)
+  TargetNormalMillis,
+  TargetMinimizedMillis,
+  TargetFullscreenMillis,
+  TargetCloakedMillis,
+  DormantWakeups,            // 休止中にイベントで起こされた
+  FocusOnlyChanges,          // ターゲットの変化がフォーカスだけだった
+  LayoutPassesAvoided,       // ターゲットが変化したが配置しなかった（フォーカスだけ・ドラッグ中・無効・休止中・収束ガード）
+  TilesDropped,              // タイル配置で MAX_TILES 個を超えたため並べなかったウィンドウ
+  NumCounters
+};
+
+constexpr std::size_t NUM_COUNTERS = static_cast<std::size_t>(Counter::NumCounters);
+static_assert(NUM_COUNTERS <= MAX_COUNTERS);
+
+constexpr const char *COUNTER_NAMES[NUM_COUNTERS] = {
+  "ticks", "targetLookups", "targetCacheHits", "adjusts",
+  "setWindowPosAttempts", "setWindowPosFailures", "accessDeniedSuppressions",
+  "monitorResets", "profileLoads", "profileSaves", "hotKeyDispatches",
+  "convergenceSettles", "convergenceBackoffs", "convergenceSuppressions",
+  "moveSizeSuppressions",
+  "targetAbsentMillis", "targetNormalMillis", "targetMinimizedMillis", "targetFullscreenMillis", "targetCloakedMillis",
+  "dormantWakeups", "focusOnlyChanges", "layoutPassesAvoided", "tilesDropped",
+};
+
+// プロセス間で共有するので、ロックを使わずに読み書きできないと困る
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+struct Block {
+  std::uint32_t magic = MAGIC;
+  std::uint32_t version = VERSION;
+  std::uint32_t numCounters = NUM_COUNTERS;
+  std::uint32_t processId = 0;
+  std::atomic<std::uint32_t> sequence{0};  // 奇数なら書き込み中
+  std::uint32_t reserved = 0;
+  std::atomic<std::uint64_t> values[MAX_COUNTERS] = {};
+};
+
+struct Counters {
+  std::uint64_t values[NUM_COUNTERS] = {};
+};
+
+struct Snapshot {
+  std::uint32_t sequence = 0;
+  std::uint32_t numCounters = 0;
+  std::uint64_t values[MAX_COUNTERS] = {};
+};
+
+// UI スレッド専用
+inline Counters &local_counters() {
+  static Counters counters;
+  return counters;
+}
+
+inline void bump(Counter c, std::uint64_t n = 1) {
+  local_counters().values[static_cast<std::size_t>(c)] += n;
+}
+
+// 書き手は一つだけであること
+inline void publish(Block &b, const Counters &c) {
+  auto seq = b.sequence.load(std::memory_order_relaxed);
+  b.sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i=0; i<NUM_COUNTERS; i++)
+    b.values[i].store(c.values[i], std::memory_order_relaxed);
+  b.sequence.store(seq + 2, std::memory_order_release);
+}
+
+// 前の書き手が残した Block を引き継ぐ。値は 0 に戻し、sequence は読み手が戻りを見ないように進めたままにする。
+// 前の書き手が書き込みの途中で死んでいて sequence が奇数のままでも、ここで偶数に戻る
+inline void adopt(Block &b, std::uint32_t processId) {
+  auto seq = b.sequence.load(std::memory_order_relaxed) | 1;
+  b.sequence.store(seq, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  b.numCounters = NUM_COUNTERS;
+  b.processId = processId;
+  for (auto &v : b.values)
+    v.store(0, std::memory_order_relaxed);
+  b.sequence.store(seq + 1, std::memory_order_release);
+}
+
+// 一貫した値が読めたら true。書き手が止まっていたり別物だったりして maxRetries 回で読めなければ false
+inline bool read(const Block &b, Snapshot &s, int maxRetries = 1000) {
+  if (b.magic != MAGIC || b.version != VERSION)
+    return false;
+  auto num = std::min<std::size_t>(b.numCounters, MAX_COUNTERS);
+  for (auto retry=0; retry<maxRetries; retry++) {
+    auto seq = b.sequence.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+    for (std::size_t i=0; i<num; i++)
+      s.values[i] = b.values[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (b.sequence.load(std::memory_order_relaxed) == seq) {
+      s.sequence = seq;
+      s.numCounters = static_cast<std::uint32_t>(num);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace Umapita::Perf
@@ -0,0 +1,80 @@
+#include "pch.h"
+#include "umapita_def.h"
+#include "umapita_perf_counters.h"
+
+//
+// 性能カウンタを読んで表示するコンソールツール
+//
+//   umapita_perf_dump.exe               … 一度だけ表示する
+//   umapita_perf_dump.exe <間隔 ms>     … Ctrl+C まで間隔ごとに表示する
+//
+// 共有メモリ Local\umapita.perf を読み取り専用で開き、Perf::read() で一貫した値を読む。
+// umapita.exe が動いていなければ終了コード 1、形式が違えば 2、読めなければ 3 を返す。
+//
+
+using namespace Umapita;
+
+namespace {
+
+enum ExitCode { Ok = 0, NotRunning = 1, Incompatible = 2, Unreadable = 3, BadArguments = 4 };
+
+void dump(const Perf::Snapshot &s, std::uint32_t processId) {
+  std::printf("pid %lu, sequence %lu\n", static_cast<unsigned long>(processId), static_cast<unsigned long>(s.sequence));
+  for (std::size_t i=0; i<s.numCounters; i++) {
+    // 新しい umapita.exe が後ろに足したカウンタは名前を知らないので番号で出す
+    auto value = std::to_string(s.values[i]);
+    if (i < Perf::NUM_COUNTERS)
+      std::printf("%-28s %s\n", Perf::COUNTER_NAMES[i], value.c_str());
+    else
+      std::printf("counter%-21u %s\n", static_cast<unsigned>(i), value.c_str());
+  }
+  std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  DWORD interval = 0;
+  if (argc > 2 || (argc == 2 && (interval = std::strtoul(argv[1], nullptr, 10)) == 0)) {
+    std::fprintf(stderr, "usage: umapita_perf_dump [interval_ms]\n");
+    return BadArguments;
+  }
+
+  auto hMapping = OpenFileMapping(FILE_MAP_READ, false, PERF_SHM_NAME);
+  if (!hMapping) {
+    std::fprintf(stderr, "umapita is not running (OpenFileMapping: %lu)\n", GetLastError());
+    return NotRunning;
+  }
+  auto p = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof (Perf::Block));
+  if (!p) {
+    std::fprintf(stderr, "MapViewOfFile: %lu\n", GetLastError());
+    CloseHandle(hMapping);
+    return Unreadable;
+  }
+  auto const &block = *static_cast<const Perf::Block *>(p);
+
+  auto ret = Ok;
+  if (block.magic != Perf::MAGIC || block.version != Perf::VERSION) {
+    std::fprintf(stderr, "incompatible layout: magic=%08lx, version=%lu (expected %08lx, %lu)\n",
+                 static_cast<unsigned long>(block.magic), static_cast<unsigned long>(block.version),
+                 static_cast<unsigned long>(Perf::MAGIC), static_cast<unsigned long>(Perf::VERSION));
+    ret = Incompatible;
+  } else {
+    do {
+      Perf::Snapshot s;
+      if (!Perf::read(block, s)) {
+        std::fprintf(stderr, "cannot read a consistent snapshot\n");
+        ret = Unreadable;
+        break;
+      }
+      dump(s, block.processId);
+      if (interval) {
+        Sleep(interval);
+        std::printf("\n");
+      }
+    } while (interval);
+  }
+  UnmapViewOfFile(p);
+  CloseHandle(hMapping);
+  return ret;
+}
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_perf_counters.h"
+#include "umapita_perf_shm.h"
+
+using namespace Umapita::Perf;
+using namespace AM;
+
+namespace {
+
+// SYSTEM, Administrators, 所有者はフルアクセス、対話ユーザは読むだけ。
+// 昇格して動いているので、整合性レベルを Medium にしておかないと普通のツールから開けない。
+constexpr TCHAR SHM_SDDL[] = TEXT("D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;GR;;;IU)S:(ML;;NW;;;ME)");
+
+} // namespace
+
+SharedCounters::SharedCounters(Win32::StrPtr name) {
+  PSECURITY_DESCRIPTOR pSecurityDescriptor = nullptr;
+  if (!ConvertStringSecurityDescriptorToSecurityDescriptor(SHM_SDDL, SDDL_REVISION_1, &pSecurityDescriptor, nullptr)) {
+    Log::warning(TEXT("cannot create security descriptor for the counters: %lu"), GetLastError());
+    pSecurityDescriptor = nullptr;
+  }
+  SECURITY_ATTRIBUTES sa{};
+  sa.nLength = sizeof (sa);
+  sa.lpSecurityDescriptor = pSecurityDescriptor;
+  sa.bInheritHandle = false;
+
+  m_hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, pSecurityDescriptor ? &sa : nullptr,
+                                 PAGE_READWRITE, 0, sizeof (Block), name.ptr);
+  auto error = GetLastError();
+  if (pSecurityDescriptor)
+    LocalFree(pSecurityDescriptor);
+  if (!m_hMapping) {
+    Log::warning(TEXT("cannot create shared memory \"%ls\": %lu"), name.ptr, error);
+    return;
+  }
+  auto p = MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, sizeof (Block));
+  if (!p) {
+    Log::warning(TEXT("cannot map shared memory \"%ls\": %lu"), name.ptr, GetLastError());
+    CloseHandle(m_hMapping);
+    m_hMapping = nullptr;
+    return;
+  }
+  if (error != ERROR_ALREADY_EXISTS) {
+    m_pBlock = new (p) Block{};
+    m_pBlock->processId = GetCurrentProcessId();
+    return;
+  }
+  // 二重起動は WinMain で弾いているので、残っているのは前のインスタンスのものを読み手（umapita_perf_dump など）が
+  // 開いたままにしているか、前のインスタンスがまだ終わりきっていないもの。同じ形式なら引き継ぐ
+  auto pBlock = static_cast<Block *>(p);
+  if (pBlock->magic != MAGIC || pBlock->version != VERSION) {
+    Log::error(TEXT("shared memory \"%ls\" already exists with an incompatible layout (magic=%08lx, version=%lu), counters are not published"),
+               name.ptr, static_cast<unsigned long>(pBlock->magic), static_cast<unsigned long>(pBlock->version));
+    UnmapViewOfFile(p);
+    CloseHandle(m_hMapping);
+    m_hMapping = nullptr;
+    return;
+  }
+  Log::info(TEXT("adopting existing shared memory \"%ls\" (previous pid=%lu)"), name.ptr, static_cast<unsigned long>(pBlock->processId));
+  m_pBlock = pBlock;
+  adopt(*m_pBlock, GetCurrentProcessId());
+}
+
+SharedCounters::~SharedCounters() {
+  if (m_pBlock) {
+    m_pBlock->~Block();
+    UnmapViewOfFile(m_pBlock);
+  }
+  if (m_hMapping)
+    CloseHandle(m_hMapping);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+namespace Umapita::Perf {
+
+//
+// 性能カウンタを置く名前付き共有メモリ
+//
+// 作れなかった場合でも何もしないだけで、本体の動作には影響しない
+//
+class SharedCounters {
+  HANDLE m_hMapping = nullptr;
+  Block *m_pBlock = nullptr;
+
+public:
+  explicit SharedCounters(AM::Win32::StrPtr name);
+  ~SharedCounters();
+  SharedCounters(const SharedCounters &) = delete;
+  SharedCounters &operator = (const SharedCounters &) = delete;
+  void publish(const Counters &c) {
+    if (m_pBlock)
+      Perf::publish(*m_pBlock, c);
+  }
+};
+
+} // namespace Umapita::Perf
@@ -6,6 +6,7 @@
 #include "umapita_def.h"
 #include "umapita_setting.h"
 #include "umapita_registry.h"
+#include "umapita_perf_counters.h"
 
 namespace Win32 = AM::Win32;
 using AM::Log;
@@ -68,7 +69,9 @@ constexpr auto PER_PROFILE_SETTING_DEF =
         make_s32(TEXT("hOffsetX"), &PerOrientation::offsetX, DEFAULT_PER_PROFILE.horizontal.offsetX),
         make_s32(TEXT("hOffsetY"), &PerOrientation::offsetY, DEFAULT_PER_PROFILE.horizontal.offsetY),
         make_s32(TEXT("hAspectX"), &PerOrientation::aspectX, DEFAULT_PER_PROFILE.horizontal.aspectX),
-        make_s32(TEXT("hAspectY"), &PerOrientation::aspectY, DEFAULT_PER_PROFILE.horizontal.aspectY)));
+        make_s32(TEXT("hAspectY"), &PerOrientation::aspectY, DEFAULT_PER_PROFILE.horizontal.aspectY)),
+      make_string(TEXT("vMonitorName"), &PerProfile::vMonitorName, DEFAULT_PER_PROFILE.vMonitorName),
+      make_string(TEXT("hMonitorName"), &PerProfile::hMonitorName, DEFAULT_PER_PROFILE.hMonitorName));
 
 constexpr auto GLOBAL_SETTING_DEF =
     make_composite_value_def<GlobalCommon>(
@@ -78,9 +81,21 @@ constexpr auto GLOBAL_SETTING_DEF =
       make_bool(TEXT("isCurrentProfileChanged"),
                            &GlobalCommon::isCurrentProfileChanged,
                            DEFAULT_GLOBAL_COMMON.isCurrentProfileChanged),
+      make_bool(TEXT("isLowMemoryMode"),
+                           &GlobalCommon::isLowMemoryMode,
+                           DEFAULT_GLOBAL_COMMON.isLowMemoryMode),
+      make_bool(TEXT("isTilingMode"),
+                           &GlobalCommon::isTilingMode,
+                           DEFAULT_GLOBAL_COMMON.isTilingMode),
+      make_bool(TEXT("isAdoptDroppedPosition"),
+                           &GlobalCommon::isAdoptDroppedPosition,
+                           DEFAULT_GLOBAL_COMMON.isAdoptDroppedPosition),
       make_string(TEXT("currentProfileName"),
                              &GlobalCommon::currentProfileName,
-                             DEFAULT_GLOBAL_COMMON.currentProfileName));
+                             DEFAULT_GLOBAL_COMMON.currentProfileName),
+      make_string(TEXT("hotKeys"),
+                             &GlobalCommon::hotKeys,
+                             DEFAULT_GLOBAL_COMMON.hotKeys));
 
 inline Win32::tstring encode_profile_name(Win32::StrPtr src) {
   Win32::tstring ret;
@@ -139,6 +154,7 @@ Win32::tstring make_regpath(Win32::StrPtr profileName) {
 
 UmapitaSetting::PerProfile load_setting(Win32::StrPtr profileName) {
   auto path = make_regpath(profileName);
+  Umapita::Perf::bump(Umapita::Perf::Counter::ProfileLoads);
 
   try {
     auto key = Win32::Reg::open_key(REG_ROOT_KEY, path, 0, KEY_READ);
@@ -146,17 +162,18 @@ UmapitaSetting::PerProfile load_setting(Win32::StrPtr profileName) {
       return PER_PROFILE_SETTING_DEF.get(key);
     }
     catch (Win32::RegMapper::GetFailed &) {
-      return UmapitaSetting::DEFAULT_PER_PROFILE;
+      return UmapitaSetting::DEFAULT_PER_PROFILE.clone<Win32::tstring>();
     }
   }
   catch (Win32::Reg::ErrorCode &ex) {
     Log::debug(TEXT("cannot read registry \"%ls\": %hs(reason=%d)"), path.c_str(), ex.what(), ex.code);
-    return UmapitaSetting::DEFAULT_PER_PROFILE;
+    return UmapitaSetting::DEFAULT_PER_PROFILE.clone<Win32::tstring>();
   }
 }
 
 void save_setting(Win32::StrPtr profileName, const UmapitaSetting::PerProfile &s) {
   auto path = make_regpath(profileName);
+  Umapita::Perf::bump(Umapita::Perf::Counter::ProfileSaves);
 
   try {
     [[maybe_unused]] auto [key, disp] = Win32::Reg::create_key(REG_ROOT_KEY, path, 0, KEY_WRITE);
@@ -256,4 +273,37 @@ bool is_profile_existing(Win32::StrPtr name) {
   return std::find(ps.begin(), ps.end(), name.ptr) != ps.end();
 }
 
+ChangeWatcher::ChangeWatcher() {
+  auto path = make_regpath(nullptr);
+  if (auto ret = RegCreateKeyEx(REG_ROOT_KEY, path.c_str(), 0, nullptr, 0, KEY_NOTIFY, nullptr, &m_hKey, nullptr); ret != ERROR_SUCCESS) {
+    Log::warning(TEXT("cannot watch registry \"%ls\": %ld"), path.c_str(), ret);
+    m_hKey = nullptr;
+    return;
+  }
+  // メッセージループで待っても消費されないように手動リセットにして、poll() で戻す
+  m_hEvent = CreateEvent(nullptr, true, false, nullptr);
+  arm();
+}
+
+ChangeWatcher::~ChangeWatcher() {
+  if (m_hKey)
+    RegCloseKey(m_hKey);
+  if (m_hEvent)
+    CloseHandle(m_hEvent);
+}
+
+void ChangeWatcher::arm() {
+  // 通知は一度きりなので、受け取るたびに掛け直す。プロファイルのサブキーは見ない
+  if (auto ret = RegNotifyChangeKeyValue(m_hKey, false, REG_NOTIFY_CHANGE_LAST_SET, m_hEvent, true); ret != ERROR_SUCCESS)
+    Log::warning(TEXT("RegNotifyChangeKeyValue failed: %ld"), ret);
+}
+
+bool ChangeWatcher::poll() {
+  if (!m_hKey || !m_hEvent || WaitForSingleObject(m_hEvent, 0) != WAIT_OBJECT_0)
+    return false;
+  ResetEvent(m_hEvent);
+  arm();
+  return true;
+}
+
 } // namespace UmapitaRegistry
@@ -11,4 +11,24 @@ void delete_profile(AM::Win32::StrPtr name);
 AM::Win32::tstring rename_profile(AM::Win32::StrPtr oldName, AM::Win32::StrPtr newName);
 bool is_profile_existing(AM::Win32::StrPtr name);
 
+//
+// 全体設定のキーの変更の監視
+// event() をメッセージループなどで待ち、シグナルされたら poll() すること（poll() が掛け直す）
+//
+class ChangeWatcher {
+  HKEY m_hKey = nullptr;
+  HANDLE m_hEvent = nullptr;
+  void arm();
+
+public:
+  ChangeWatcher();
+  ~ChangeWatcher();
+  ChangeWatcher(const ChangeWatcher &) = delete;
+  ChangeWatcher &operator = (const ChangeWatcher &) = delete;
+  // 変更があるとシグナルされる手動リセットのイベント。監視できなければ nullptr
+  HANDLE event() const { return m_hEvent; }
+  // 前回から変更があれば true
+  bool poll();
+};
+
 } // namespace UmapitaRegistry
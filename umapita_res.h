@@ -9,6 +9,8 @@
 #define IDM_V_MONITOR_BASE 0x2000
 #define IDM_H_MONITOR_BASE 0x3000
 #define MAX_AVAILABLE_MONITORS 64
+#define IDM_V_MONITOR_FOLLOW (IDM_V_MONITOR_BASE+MAX_AVAILABLE_MONITORS+2)
+#define IDM_H_MONITOR_FOLLOW (IDM_H_MONITOR_BASE+MAX_AVAILABLE_MONITORS+2)
 
 #define IDC_QUIT 0x300
 #define IDC_SHOW 0x301
@@ -17,6 +19,9 @@
 #define IDC_ENABLED 0x304
 #define IDC_SELECT_PROFILE 0x305
 #define IDC_OPEN_PROFILE_MENU 0x306
+#define IDC_LOW_MEMORY_MODE 0x307
+#define IDC_TILING_MODE 0x308
+#define IDC_ADOPT_DROPPED_POSITION 0x309
 #define IDC_V_MONITOR_NUMBER 0x310
 #define IDC_V_SELECT_MONITORS 0x311
 #define IDC_V_WHOLE_AREA 0x312
@@ -84,9 +89,12 @@
 #define IDS_SAVE_AS_DETAIL 0x40E
 #define IDS_RENAME_TITLE 0x40F
 #define IDS_RENAME_DETAIL 0x410
+#define IDS_CONVERGENCE_SETTLED 0x411
+#define IDS_CONVERGENCE_BACKING_OFF 0x412
 
 #define IDI_UMAPITA 0x500
 
 #define IDA_UMAPITA 0x600
 
 #define UMAPITA_MAIN_WINDOW_CLASS "umapita main"
+#define UMAPITA_HOST_WINDOW_CLASS "umapita host"
@@ -0,0 +1,270 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// 遅延実行・周期実行のためのスケジューラ（階層化タイマホイール）
+//
+// 1ms 刻みで 64 スロット x 4 段のホイールを持ち、それより先（約 4.6 時間以上）の予定は m_overflow に置く。
+// 予定の登録・取り消しは O(1)、時刻を進めるときは予定のあるスロットの境目だけに飛ぶので、暇なときの時間は数えない。
+// 取り消しは遅延させていて、スロットを処理するときに Entry と食い違う Ref を捨てる。
+//
+// 各予定は slack を持ち、[予定時刻, 予定時刻 + slack] のどこで実行してもよい。
+// 呼び出し側は next_wake() の delay と tolerance でタイマを一つだけ（SetCoalescableTimer などで）掛け、
+// 鳴ったら run_due() を呼ぶ。OS が他のタイマとまとめて起こせるように、tolerance はどの予定の slack も破らない範囲で最大にする。
+//
+// OS に依存しないように標準ライブラリだけで書いてあり、ManualClock を渡せば時刻を手で進められる。
+// UI スレッド専用。
+//
+class Scheduler {
+public:
+  using Time = std::uint64_t;    // ms
+  using TaskId = std::uint64_t;  // 0 は無効
+  using Clock = std::function<Time ()>;
+  using Task = std::function<void ()>;
+
+  struct Wake {
+    Time delay;      // 今からこれだけ後に
+    Time tolerance;  // これだけ遅れてもよい
+  };
+
+private:
+  static constexpr unsigned LEVEL_BITS = 6;
+  static constexpr unsigned SLOTS = 1U << LEVEL_BITS;
+  static constexpr unsigned LEVELS = 4;
+  static constexpr unsigned SPAN_BITS = LEVEL_BITS * LEVELS;
+  static constexpr Time NEVER = ~Time{0};
+
+  struct Entry {
+    Time expiry;
+    Time slack;
+    Time period;  // 0 なら一回だけ
+    Task task;
+  };
+  struct Ref {
+    TaskId id;
+    Time expiry;  // Entry の expiry と違えば、取り消されたか入れ直された古いもの
+  };
+
+  Clock m_clock;
+  Time m_now;  // ホイールの上でここまで処理した
+  TaskId m_nextId = 1;
+  std::unordered_map<TaskId, Entry> m_entries;
+  std::vector<Ref> m_wheel[LEVELS][SLOTS];
+  std::uint64_t m_occupied[LEVELS] = {};
+  std::vector<Ref> m_overflow;
+  std::vector<Ref> m_due;
+
+  static Time steady_clock_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  static unsigned shift_of(unsigned level) { return LEVEL_BITS * level; }
+  // level 段目の index より後ろのスロットに予定があれば、その番号。なければ SLOTS
+  static unsigned next_occupied(std::uint64_t occupied, unsigned index) {
+    auto mask = index + 1 < SLOTS ? occupied & (~std::uint64_t{0} << (index + 1)) : 0;
+    return mask ? __builtin_ctzll(mask) : SLOTS;
+  }
+  unsigned current_index(unsigned level) const { return (m_now >> shift_of(level)) & (SLOTS - 1); }
+  // level 段目の slot 番目のスロットを処理する時刻
+  Time slot_start(unsigned level, unsigned slot) const {
+    auto upper = shift_of(level) + LEVEL_BITS;
+    return ((m_now >> upper) << upper) + (Time{slot} << shift_of(level));
+  }
+
+  bool is_live(const Ref &r) const {
+    auto it = m_entries.find(r.id);
+    return it != m_entries.end() && it->second.expiry == r.expiry;
+  }
+
+  // level 段目の index より後ろで、生きている予定のある最初のスロット。取り消されたものしかないスロットは掃除する
+  unsigned next_live_slot(unsigned level, unsigned index) {
+    auto slot = next_occupied(m_occupied[level], index);
+    for (; slot < SLOTS; slot = next_occupied(m_occupied[level], slot)) {
+      auto &refs = m_wheel[level][slot];
+      refs.erase(std::remove_if(refs.begin(), refs.end(), [this](auto const &r) { return !is_live(r); }), refs.end());
+      if (!refs.empty())
+        break;
+      m_occupied[level] &= ~(std::uint64_t{1} << slot);
+    }
+    return slot;
+  }
+
+  void insert(const Ref &r) {
+    if (r.expiry <= m_now) {
+      m_due.push_back(r);
+      return;
+    }
+    // 上位のビットが m_now と同じになる一番下の段に置く
+    for (unsigned level=0; level<LEVELS; level++) {
+      auto upper = shift_of(level) + LEVEL_BITS;
+      if ((r.expiry >> upper) == (m_now >> upper)) {
+        auto slot = (r.expiry >> shift_of(level)) & (SLOTS - 1);
+        m_wheel[level][slot].push_back(r);
+        m_occupied[level] |= std::uint64_t{1} << slot;
+        return;
+      }
+    }
+    m_overflow.push_back(r);
+  }
+
+  // スロットの中身を一つ下の段（0 段目なら m_due）に移す
+  void cascade(std::vector<Ref> &refs) {
+    auto taken = std::move(refs);
+    refs.clear();
+    for (auto const &r : taken)
+      if (is_live(r))
+        insert(r);
+  }
+
+  // m_now の次に何かを処理する必要がある時刻
+  Time next_event() const {
+    auto ret = NEVER;
+    for (unsigned level=0; level<LEVELS; level++)
+      if (auto slot = next_occupied(m_occupied[level], current_index(level)); slot < SLOTS)
+        ret = std::min(ret, slot_start(level, slot));
+    if (!m_overflow.empty())
+      ret = std::min(ret, ((m_now >> SPAN_BITS) + 1) << SPAN_BITS);
+    return ret;
+  }
+
+  void step_to(Time t) {
+    m_now = t;
+    if ((t & ((Time{1} << SPAN_BITS) - 1)) == 0)
+      cascade(m_overflow);
+    // 上の段から順に崩す。下の段に落ちてきたものが同じ時刻に処理されることがある
+    for (auto level=LEVELS; level-- > 0; ) {
+      if ((t & ((Time{1} << shift_of(level)) - 1)) != 0)
+        continue;
+      auto slot = current_index(level);
+      m_occupied[level] &= ~(std::uint64_t{1} << slot);
+      cascade(m_wheel[level][slot]);
+    }
+  }
+
+  void advance(Time now) {
+    while (m_now < now) {
+      auto next = next_event();
+      if (next > now) {
+        // 間には何もないので一気に飛ぶ
+        m_now = now;
+        break;
+      }
+      step_to(next);
+    }
+  }
+
+  TaskId add(Time delay, Time slack, Time period, Task task) {
+    auto id = m_nextId++;
+    auto expiry = m_clock() + delay;
+    m_entries.emplace(id, Entry{expiry, slack, period, std::move(task)});
+    insert(Ref{id, expiry});
+    return id;
+  }
+
+  // 生きている予定について、一番早い予定時刻と、それを含めて全部の slack を守れる最も遅い時刻を集める
+  void collect(const std::vector<Ref> &refs, Time &deadline, Time &wakeBy) const {
+    for (auto const &r : refs) {
+      if (auto it = m_entries.find(r.id); it != m_entries.end() && it->second.expiry == r.expiry) {
+        deadline = std::min(deadline, r.expiry);
+        wakeBy = std::min(wakeBy, r.expiry + it->second.slack);
+      }
+    }
+  }
+
+public:
+  Scheduler() : Scheduler{steady_clock_ms} { }
+  explicit Scheduler(Clock clock) : m_clock{std::move(clock)}, m_now{m_clock()} { }
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator = (const Scheduler &) = delete;
+
+  Time now() const { return m_clock(); }
+
+  // delay 後に一回だけ実行する
+  TaskId schedule_once(Time delay, Time slack, Task task) {
+    return add(delay, slack, 0, std::move(task));
+  }
+  // period ごとに実行する。遅れて取りこぼした回はまとめて一回にし、位相は最初の予定に合わせたままにする
+  TaskId schedule_periodic(Time period, Time slack, Task task) {
+    return add(std::max<Time>(period, 1), slack, std::max<Time>(period, 1), std::move(task));
+  }
+  // まだ実行されていなければ取り消して true を返す。実行中のタスクが自分を取り消してもよい
+  bool cancel(TaskId id) {
+    return m_entries.erase(id) > 0;
+  }
+  bool is_scheduled(TaskId id) const {
+    return m_entries.count(id) > 0;
+  }
+  std::size_t size() const { return m_entries.size(); }
+
+  // 予定時刻を過ぎたものを予定時刻の順に実行し、実行した数を返す。
+  // タスクの中で登録したもののうち、もう予定時刻を過ぎているものは次の run_due() で実行する
+  std::size_t run_due() {
+    advance(m_clock());
+    auto due = std::move(m_due);
+    m_due.clear();
+    std::sort(due.begin(), due.end(), [](auto const &lhs, auto const &rhs) {
+                                        return lhs.expiry != rhs.expiry ? lhs.expiry < rhs.expiry : lhs.id < rhs.id;
+                                      });
+    std::size_t ran = 0;
+    for (auto const &r : due) {
+      auto it = m_entries.find(r.id);
+      if (it == m_entries.end() || it->second.expiry != r.expiry)
+        continue;
+      auto &e = it->second;
+      Task task;
+      if (e.period) {
+        // 実行する前に次の回を入れておく（タスクが自分を取り消せるように）
+        e.expiry += ((m_now - e.expiry) / e.period + 1) * e.period;
+        insert(Ref{r.id, e.expiry});
+        task = e.task;
+      } else {
+        task = std::move(e.task);
+        m_entries.erase(it);
+      }
+      task();
+      ran++;
+    }
+    return ran;
+  }
+
+  // 次にいつ run_due() を呼べばよいか。予定がなければ空
+  std::optional<Wake> next_wake() {
+    auto now = m_clock();
+    advance(now);
+    auto deadline = NEVER, wakeBy = NEVER;
+    collect(m_due, deadline, wakeBy);
+    for (unsigned level=0; level<LEVELS; level++) {
+      auto slot = next_live_slot(level, current_index(level));
+      if (slot == SLOTS)
+        continue;
+      collect(m_wheel[level][slot], deadline, wakeBy);
+      // その後ろのスロットの予定は、そのスロットの始まりより前には来ない
+      if (auto second = next_live_slot(level, slot); second < SLOTS)
+        wakeBy = std::min(wakeBy, slot_start(level, second));
+    }
+    collect(m_overflow, deadline, wakeBy);
+    if (deadline == NEVER)
+      return std::nullopt;
+    deadline = std::max(deadline, now);
+    return Wake{deadline - now, std::max(wakeBy, deadline) - deadline};
+  }
+};
+
+//
+// テスト用の手で進める時計
+//
+//   ManualClock clock;
+//   Scheduler scheduler{clock.clock()};
+//   clock.advance(100);
+//   scheduler.run_due();
+//
+class ManualClock {
+  Scheduler::Time m_now = 0;
+
+public:
+  Scheduler::Time now() const { return m_now; }
+  void advance(Scheduler::Time ms) { m_now += ms; }
+  Scheduler::Clock clock() { return [this] { return m_now; }; }
+};
+
+} // namespace Umapita
@@ -3,7 +3,7 @@
 namespace UmapitaSetting {
 
 struct PerOrientation {
-  LONG monitorNumber = 0;
+  LONG monitorNumber = 0;  // MONITOR_NUMBER_FOLLOW ならターゲットが今いるモニタ
   bool isConsiderTaskbar;
   enum WindowArea { Whole, Client } windowArea;
   LONG size = 0;
@@ -13,7 +13,8 @@ struct PerOrientation {
   LONG aspectX, aspectY; // XXX: アスペクト比を固定しないと計算誤差で変な比率になることがある
 };
 
-struct PerProfile {
+template <typename StringType>
+struct PerProfileT {
   bool isLocked = false;
   // .xxx=xxx 記法は ISO C++20 からだが、gcc なら使えるのでヨシ！
   PerOrientation vertical{
@@ -28,18 +29,37 @@ struct PerProfile {
     .aspectX=16,
     .aspectY=9
   };
+  // 空でなければ、そのモニタが繋がっている間は monitorNumber より優先する
+  StringType vMonitorName{TEXT("")};
+  StringType hMonitorName{TEXT("")};
+  const StringType &monitor_name(bool isHorizontal) const { return isHorizontal ? hMonitorName : vMonitorName; }
+  template <typename T>
+  PerProfileT<T> clone() const {
+    return PerProfileT<T>{isLocked, vertical, horizontal, vMonitorName, hMonitorName};
+  }
 };
+using PerProfile = PerProfileT<AM::Win32::tstring>;
+
+constexpr PerProfileT<LPCTSTR> DEFAULT_PER_PROFILE{};
 
-constexpr PerProfile DEFAULT_PER_PROFILE{};
+// 従来どおり Alt+1 ～ Alt+9, Alt+0 で 1 ～ 10 番目のプロファイルを選ぶ
+constexpr TCHAR DEFAULT_HOT_KEYS[] =
+  TEXT("Alt+1=select:1;Alt+2=select:2;Alt+3=select:3;Alt+4=select:4;Alt+5=select:5;")
+  TEXT("Alt+6=select:6;Alt+7=select:7;Alt+8=select:8;Alt+9=select:9;Alt+0=select:10");
 
 template <typename StringType>
 struct GlobalCommonT {
   bool isEnabled = true;
   bool isCurrentProfileChanged = false;
+  bool isLowMemoryMode = false;  // 非表示にしたときにダイアログを破棄する
+  bool isTilingMode = false;  // ターゲットが複数あるときはタイル状に並べる
+  bool isAdoptDroppedPosition = false;  // ターゲットをドラッグで動かしたら、その位置をオフセットとして取り込む
   StringType currentProfileName{TEXT("")};  // XXX: gcc10 の libstdc++ でも basic_string は constexpr 化されてない
+  StringType hotKeys{DEFAULT_HOT_KEYS};  // 書式は umapita_hot_key.h を参照
   template <typename T>
   GlobalCommonT<T> clone() const {
-    return GlobalCommonT<T>{isEnabled, isCurrentProfileChanged, currentProfileName};
+    return GlobalCommonT<T>{isEnabled, isCurrentProfileChanged, isLowMemoryMode, isTilingMode, isAdoptDroppedPosition,
+                            currentProfileName, hotKeys};
   }
 };
 using GlobalCommon = GlobalCommonT<AM::Win32::tstring>;
@@ -50,10 +70,10 @@ constexpr GlobalCommonT<LPCTSTR> DEFAULT_GLOBAL_COMMON{};
 template <typename StringType>
 struct GlobalT {
   GlobalCommonT<StringType> common{DEFAULT_GLOBAL_COMMON};
-  PerProfile currentProfile{DEFAULT_PER_PROFILE};
+  PerProfileT<StringType> currentProfile{DEFAULT_PER_PROFILE};
   template <typename T>
   GlobalT<T> clone() const {
-    return GlobalT<T>{common.template clone<T>(), currentProfile};
+    return GlobalT<T>{common.template clone<T>(), currentProfile.template clone<T>()};
   }
 };
 using Global = GlobalT<AM::Win32::tstring>;
@@ -0,0 +1,41 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// 起動時間の計測
+//
+// 生成時点からトラッカーの準備完了・最初の配置までの時間をログに出す
+//
+class StartupProbe {
+  LARGE_INTEGER m_frequency;
+  LARGE_INTEGER m_start;
+  bool m_isTrackerReady = false;
+  bool m_isFirstPlacementDone = false;
+
+  double elapsed_ms() const {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return static_cast<double>(now.QuadPart - m_start.QuadPart) * 1000.0 / static_cast<double>(m_frequency.QuadPart);
+  }
+
+public:
+  StartupProbe() {
+    QueryPerformanceFrequency(&m_frequency);
+    QueryPerformanceCounter(&m_start);
+  }
+  void mark_tracker_ready() {
+    if (!m_isTrackerReady) {
+      m_isTrackerReady = true;
+      AM::Log::info(TEXT("startup: tracker ready in %.3fms"), elapsed_ms());
+    }
+  }
+  void mark_first_placement() {
+    if (!m_isFirstPlacementDone) {
+      m_isFirstPlacementDone = true;
+      AM::Log::info(TEXT("startup: first placement in %.3fms"), elapsed_ms());
+    }
+  }
+};
+
+} // namespace Umapita
@@ -1,36 +1,98 @@
 #include "pch.h"
 #include "am/win32util.h"
 #include "umapita_def.h"
+#include "umapita_monitor_index.h"
 #include "umapita_monitors.h"
 #include "umapita_setting.h"
 #include "umapita_target_status.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
 
 using namespace Umapita;
 using namespace AM;
 using Win32::Window;
 
-TargetStatus TargetStatus::get(Win32::StrPtr winclass, Win32::StrPtr winname) {
-  if (auto target = Window::find(winclass, winname); target) {
-    try {
-      auto wi = target.get_info();
-
-      // ターゲットウィンドウにフォーカスがあるかをチェックする
-      GUITHREADINFO gti;
-      gti.cbSize = sizeof (GUITHREADINFO);
-      auto ifo = false;
-      if (GetGUIThreadInfo(0, &gti)) {
-        ifo = target.get() == gti.hwndFocus;
-      }
+namespace {
 
-      return {target, ifo, wi.rcWindow, wi.rcClient};
-    }
-    catch (Win32::Win32ErrorCode &) {
-    }
+TargetStatus make_target_status(Window target, HWND hwndFocus) {
+  try {
+    auto wi = target.get_info();
+    return {target, target.get() == hwndFocus, wi.rcWindow, wi.rcClient, TargetStatus::classify(target)};
+  }
+  catch (Win32::Win32ErrorCode &) {
+  }
+  return {};
+}
+
+// ターゲットウィンドウにフォーカスがあるかのチェックに使う
+HWND get_focus_window() {
+  GUITHREADINFO gti;
+  gti.cbSize = sizeof (GUITHREADINFO);
+  return GetGUIThreadInfo(0, &gti) ? gti.hwndFocus : nullptr;
+}
+
+} // namespace
+
+const UmapitaMonitors::Monitor *TargetStatus::select_monitor(const UmapitaMonitors &monitors,
+                                                             const UmapitaSetting::PerOrientation &s,
+                                                             const Win32::tstring &monitorName,
+                                                             const RECT &windowRect) {
+  // 名前で指定されていれば、そのモニタが繋がっている間はそちらを使う
+  if (!monitorName.empty()) {
+    if (auto m = monitors.get_monitor_by_name(monitorName); m)
+      return m;
+  }
+  if (s.monitorNumber == MONITOR_NUMBER_FOLLOW) {
+    // どのモニタにもかかっていなければプライマリモニタに戻す
+    if (auto m = monitors.get_monitor_by_rect(windowRect); m)
+      return m;
+    return monitors.get_monitor_by_number(0);
   }
+  return monitors.get_monitor_by_number(s.monitorNumber);
+}
+
+TargetStatus TargetStatus::get(Win32::StrPtr winclass, Win32::StrPtr winname) {
+  if (auto target = Window::find(winclass, winname); target)
+    return make_target_status(target, get_focus_window());
   return {};
 }
 
-void TargetStatus::adjust(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile) {
+TargetState TargetStatus::classify(Window window) {
+  if (!window)
+    return TargetState::Absent;
+  if (IsIconic(window.get()))
+    return TargetState::Minimized;
+  // 別の仮想デスクトップにいるときやストアアプリが中断しているときはクロークされている
+  DWORD cloaked = 0;
+  if (SUCCEEDED(DwmGetWindowAttribute(window.get(), DWMWA_CLOAKED, &cloaked, sizeof (cloaked))) && cloaked)
+    return TargetState::Cloaked;
+  // 排他的全画面は前面にいるときにしか起きないので、シェルに問い合わせるのはそのときだけにする
+  if (GetForegroundWindow() == window.get()) {
+    QUERY_USER_NOTIFICATION_STATE state;
+    if (SUCCEEDED(SHQueryUserNotificationState(&state)) && state == QUNS_RUNNING_D3D_FULL_SCREEN)
+      return TargetState::Fullscreen;
+  }
+  return TargetState::Normal;
+}
+
+std::vector<TargetStatus> TargetStatus::get_all(Win32::StrPtr winclass, Win32::StrPtr winname) {
+  std::vector<TargetStatus> ret;
+  auto hwndFocus = get_focus_window();
+  HWND hWnd = nullptr;
+  while ((hWnd = FindWindowEx(nullptr, hWnd, winclass.ptr, winname.ptr)) != nullptr) {
+    if (auto ts = make_target_status(Window{hWnd}, hwndFocus); ts.window)
+      ret.emplace_back(ts);
+  }
+  // 列挙順は Z オーダーなのでフォーカスが移るたびに変わる。並びが変わらないようにハンドルの値で並べる
+  std::sort(ret.begin(), ret.end(),
+            [](auto const &lhs, auto const &rhs) {
+              return reinterpret_cast<std::uintptr_t>(lhs.window.get()) < reinterpret_cast<std::uintptr_t>(rhs.window.get());
+            });
+  return ret;
+}
+
+void TargetStatus::adjust(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile, ConvergenceGuard &guard) {
+  Perf::bump(Perf::Counter::Adjusts);
   if (this->window && this->window.is_visible()) {
     // ターゲットのジオメトリを更新する
     auto cW = Win32::width(this->clientRect);
@@ -45,7 +107,7 @@ void TargetStatus::adjust(const UmapitaMonitors &monitors, const UmapitaSetting:
     auto ncH = wH - cH;
     const UmapitaSetting::PerOrientation &s = cW > cH ? profile.horizontal : profile.vertical;
 
-    auto maybeMonitor = monitors.get_monitor_by_number(s.monitorNumber);
+    auto maybeMonitor = select_monitor(monitors, s, profile.monitor_name(cW > cH), this->windowRect);
     if (!maybeMonitor) {
       Log::warning(TEXT("invalid monitor number: %d"), s.monitorNumber);
       return;
@@ -130,25 +192,45 @@ void TargetStatus::adjust(const UmapitaMonitors &monitors, const UmapitaSetting:
     auto idealCX = idealX - ncX;
     auto idealCY = idealY - ncY;
     Log::debug(TEXT("%p, x=%ld, y=%ld, w=%ld, h=%ld"), this->window.get(), idealX, idealY, idealW, idealH);
-    if ((idealX != this->windowRect.left || idealY != this->windowRect.top || idealW != wW || idealH != wH) &&
-        idealW > MIN_WIDTH && idealH > MIN_HEIGHT) {
+    auto idealRect = RECT{idealX, idealY, idealX+idealW, idealY+idealH};
+    if (idealX == this->windowRect.left && idealY == this->windowRect.top && idealW == wW && idealH == wH)
+      guard.on_ideal();
+    else if (idealW > MIN_WIDTH && idealH > MIN_HEIGHT &&
+             guard.should_attempt(this->window.get(), idealRect, this->windowRect, GetTickCount64())) {
       auto willingToUpdate = true;
+      Perf::bump(Perf::Counter::SetWindowPosAttempts);
       try {
         this->window.set_pos(Window{}, idealX, idealY, idealW, idealH, SWP_NOACTIVATE | SWP_NOZORDER);
       }
       catch (Win32::Win32ErrorCode &ex) {
         // SetWindowPos に失敗
         Log::error(TEXT("SetWindowPos failed: %lu\n"), ex.code);
+        Perf::bump(Perf::Counter::SetWindowPosFailures);
         if (ex.code == ERROR_ACCESS_DENIED) {
           // 権限がない場合、どうせ次も失敗するので ts を変更前の値のままにしておく。
           // これで余計な更新が走らなくなる。
           willingToUpdate = false;
+          Perf::bump(Perf::Counter::AccessDeniedSuppressions);
         }
       }
-      if (willingToUpdate) {
-        this->windowRect = RECT{idealX, idealY, idealX+idealW, idealY+idealH};
-        this->clientRect = RECT{idealCX, idealCY, idealCX+idealCW, idealCY+idealCH};
-      }
-    }
+      if (willingToUpdate)
+        update_after_move(idealRect, RECT{idealCX, idealCY, idealCX+idealCW, idealCY+idealCH}, guard);
+    } else
+      Perf::bump(Perf::Counter::LayoutPassesAvoided);
+  }
+}
+
+void TargetStatus::update_after_move(const RECT &expectedWindow, const RECT &expectedClient, ConvergenceGuard &guard) {
+  this->windowRect = expectedWindow;
+  this->clientRect = expectedClient;
+  // 丸められていることがあるので実際の矩形を読み直す。
+  // 予想の値のままだと次の tick で差分が出て、また同じ要求を繰り返してしまう
+  try {
+    auto wi = this->window.get_info();
+    this->windowRect = wi.rcWindow;
+    this->clientRect = wi.rcClient;
+  }
+  catch (Win32::Win32ErrorCode &) {
   }
+  guard.on_result(this->windowRect);
 }
@@ -2,6 +2,14 @@
 
 namespace Umapita {
 
+class ConvergenceGuard;
+
+//
+// 監視対象ウィンドウの大まかな状態
+// Minimized, Fullscreen, Cloaked のときは配置しても意味がないので、トラッカーは休止する
+//
+enum class TargetState { Absent, Normal, Minimized, Fullscreen, Cloaked };
+
 //
 // 監視対象ウィンドウの状態
 //
@@ -10,19 +18,74 @@ struct TargetStatus {
   bool isFocusOn;
   RECT windowRect{0, 0, 0, 0};
   RECT clientRect{0, 0, 0, 0};
+  TargetState state = TargetState::Absent;  // get(), get_all() のときに classify() したもの
   static TargetStatus get(AM::Win32::StrPtr winclass, AM::Win32::StrPtr winname);
-  void adjust(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile);
+  static TargetState classify(AM::Win32::Window window);
+  // 条件に合うウィンドウをすべて集める（ハンドルの順）
+  static std::vector<TargetStatus> get_all(AM::Win32::StrPtr winclass, AM::Win32::StrPtr winname);
+  // 向きの設定 s と名前による指定 monitorName に従って配置先のモニタを決める
+  static const UmapitaMonitors::Monitor *select_monitor(const UmapitaMonitors &monitors,
+                                                        const UmapitaSetting::PerOrientation &s,
+                                                        const AM::Win32::tstring &monitorName,
+                                                        const RECT &windowRect);
+  void adjust(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile, ConvergenceGuard &guard);
+  // expectedWindow, expectedClient に動かした後で実際の矩形を読み直し（読めなければ予想の値にする）、guard に結果を知らせる
+  void update_after_move(const RECT &expectedWindow, const RECT &expectedClient, ConvergenceGuard &guard);
 };
 
 inline bool operator == (const TargetStatus &lhs, const TargetStatus &rhs) {
   using AM::Win32::Op::operator ==;
   return lhs.window == rhs.window && (!lhs.window || (lhs.isFocusOn == rhs.isFocusOn &&
                                                       lhs.windowRect == rhs.windowRect &&
-                                                      lhs.clientRect == rhs.clientRect));
+                                                      lhs.clientRect == rhs.clientRect &&
+                                                      lhs.state == rhs.state));
 }
 
 inline bool operator != (const TargetStatus &lhs, const TargetStatus &rhs) {
   return !(lhs == rhs);
 }
 
+//
+// 前回の状態からの変化の種類
+//
+// 使う側はそれぞれ自分に関係する種類だけを見る（配置は Identity と Geometry、ホットキーは Identity と Focus など）。
+// Identity が変わったら、他の種類もすべて変わったものとして扱う。
+//
+using TargetChangeMask = unsigned;
+
+namespace TargetChange {
+constexpr TargetChangeMask None = 0;
+constexpr TargetChangeMask Identity = 1 << 0;  // ウィンドウが現れた・消えた・別のものになった
+constexpr TargetChangeMask Focus = 1 << 1;
+constexpr TargetChangeMask Geometry = 1 << 2;  // windowRect か clientRect
+constexpr TargetChangeMask State = 1 << 3;     // 最小化・全画面・クロークに入った・出た（矩形が変わらないこともある）
+constexpr TargetChangeMask All = Identity | Focus | Geometry | State;
+} // namespace TargetChange
+
+inline TargetChangeMask diff(const TargetStatus &prev, const TargetStatus &cur) {
+  using AM::Win32::Op::operator ==;
+  if (!(prev.window == cur.window))
+    return TargetChange::All;
+  if (!cur.window)
+    return TargetChange::None;
+  auto ret = TargetChange::None;
+  if (prev.isFocusOn != cur.isFocusOn)
+    ret |= TargetChange::Focus;
+  if (!(prev.windowRect == cur.windowRect) || !(prev.clientRect == cur.clientRect))
+    ret |= TargetChange::Geometry;
+  if (prev.state != cur.state)
+    ret |= TargetChange::State;
+  return ret;
+}
+
+// 並びが同じなら要素ごとの変化を合わせたもの
+inline TargetChangeMask diff(const std::vector<TargetStatus> &prev, const std::vector<TargetStatus> &cur) {
+  if (prev.size() != cur.size())
+    return TargetChange::All;
+  auto ret = TargetChange::None;
+  for (std::size_t i=0; i<cur.size(); i++)
+    ret |= diff(prev[i], cur[i]);
+  return ret;
+}
+
 } // namespace Umapita
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_monitor_index.h"
+#include "umapita_monitors.h"
+#include "umapita_setting.h"
+#include "umapita_target_status.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
+#include "umapita_tiling_solver.h"
+#include "umapita_tiling.h"
+
+using namespace Umapita;
+using namespace AM;
+using Win32::Window;
+using UmapitaSetting::PerOrientation;
+
+namespace {
+
+// 原点の横方向・縦方向の成分（-1: 西/北, 0: 中央, 1: 東/南）
+int horizontal_align(PerOrientation::Origin origin) {
+  switch (origin) {
+  case PerOrientation::NW:
+  case PerOrientation::W:
+  case PerOrientation::SW:
+    return -1;
+  case PerOrientation::NE:
+  case PerOrientation::E:
+  case PerOrientation::SE:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int vertical_align(PerOrientation::Origin origin) {
+  switch (origin) {
+  case PerOrientation::NW:
+  case PerOrientation::N:
+  case PerOrientation::NE:
+    return -1;
+  case PerOrientation::SW:
+  case PerOrientation::S:
+  case PerOrientation::SE:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+} // namespace
+
+void Tiling::apply(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile, std::vector<TargetStatus> &targets,
+                   ConvergenceGuards &guards) {
+  Perf::bump(Perf::Counter::Adjusts);
+  // 最小化やクロークされたもの（別の仮想デスクトップなど）、排他的全画面のものは並べない
+  std::vector<TargetStatus *> visibles;
+  for (auto &ts : targets)
+    if (ts.window && ts.window.is_visible() && ts.state == TargetState::Normal)
+      visibles.push_back(&ts);
+  if (visibles.empty())
+    return;
+  // 候補の数が倍々に増えるので、並べるのは列挙順（ハンドルの順）で先頭の MAX_TILES 個だけにする
+  if (visibles.size() > MAX_TILES) {
+    Log::warning(TEXT("too many windows to tile: %u, leaving %u of them as they are"),
+                 static_cast<unsigned>(visibles.size()), static_cast<unsigned>(visibles.size() - MAX_TILES));
+    Perf::bump(Perf::Counter::TilesDropped, visibles.size() - MAX_TILES);
+    visibles.resize(MAX_TILES);
+  }
+
+  auto is_horizontal = [](const TargetStatus &ts) {
+                         return Win32::width(ts.clientRect) > Win32::height(ts.clientRect);
+                       };
+  std::vector<Tile> tiles;
+  for (auto *ts : visibles) {
+    auto const &s = is_horizontal(*ts) ? profile.horizontal : profile.vertical;
+    tiles.push_back(Tile{s.aspectX, s.aspectY,
+                         Win32::width(ts->windowRect) - Win32::width(ts->clientRect),
+                         Win32::height(ts->windowRect) - Win32::height(ts->clientRect)});
+  }
+
+  // モニタ・タスクバー・原点は先頭のウィンドウの向きの設定に従う
+  auto const &head = *visibles.front();
+  auto isHorizontal = is_horizontal(head);
+  auto const &s = isHorizontal ? profile.horizontal : profile.vertical;
+  auto maybeMonitor = TargetStatus::select_monitor(monitors, s, profile.monitor_name(isHorizontal), head.windowRect);
+  if (!maybeMonitor) {
+    Log::warning(TEXT("invalid monitor number: %d"), s.monitorNumber);
+    return;
+  }
+  auto rects = solve(tiles, s.isConsiderTaskbar ? maybeMonitor->work : maybeMonitor->whole,
+                     horizontal_align(s.origin), vertical_align(s.origin), s.offsetX, s.offsetY);
+  if (rects.empty()) {
+    Log::warning(TEXT("cannot tile %u windows"), static_cast<unsigned>(tiles.size()));
+    return;
+  }
+
+  // 変化するものだけを一回の DeferWindowPos でまとめて動かす。
+  // 収束ガードはウィンドウごとに見るので、一つが取り合いになっても他のものは配置し続ける
+  using Win32::Op::operator ==;
+  auto now = GetTickCount64();
+  std::vector<std::size_t> moves;
+  auto isSuppressed = false;
+  for (std::size_t i=0; i<rects.size(); i++) {
+    auto const &rc = rects[i];
+    auto const &ts = *visibles[i];
+    auto &guard = guards[ts.window.get()];
+    if (rc == ts.windowRect)
+      guard.on_ideal();
+    else if (Win32::width(rc) > MIN_WIDTH && Win32::height(rc) > MIN_HEIGHT &&
+             guard.should_attempt(ts.window.get(), rc, ts.windowRect, now))
+      moves.push_back(i);
+    else
+      isSuppressed = true;
+  }
+  if (moves.empty()) {
+    if (isSuppressed)
+      Perf::bump(Perf::Counter::LayoutPassesAvoided);
+    return;
+  }
+
+  Perf::bump(Perf::Counter::SetWindowPosAttempts, moves.size());
+  auto hdwp = BeginDeferWindowPos(static_cast<int>(moves.size()));
+  for (auto i : moves) {
+    if (!hdwp)
+      break;
+    auto const &rc = rects[i];
+    Log::debug(TEXT("%p, x=%ld, y=%ld, w=%ld, h=%ld"), visibles[i]->window.get(), rc.left, rc.top, Win32::width(rc), Win32::height(rc));
+    hdwp = DeferWindowPos(hdwp, visibles[i]->window.get(), nullptr, rc.left, rc.top, Win32::width(rc), Win32::height(rc),
+                          SWP_NOACTIVATE | SWP_NOZORDER);
+  }
+  if (!hdwp || !EndDeferWindowPos(hdwp)) {
+    // 一つでも失敗するとまとめて捨てられるので、一つずつ動かし直す
+    Log::warning(TEXT("DeferWindowPos failed: %lu"), GetLastError());
+    Perf::bump(Perf::Counter::SetWindowPosFailures);
+    std::vector<std::size_t> succeeded;
+    for (auto i : moves) {
+      auto const &rc = rects[i];
+      try {
+        visibles[i]->window.set_pos(Window{}, rc.left, rc.top, Win32::width(rc), Win32::height(rc), SWP_NOACTIVATE | SWP_NOZORDER);
+        succeeded.push_back(i);
+      }
+      catch (Win32::Win32ErrorCode &ex) {
+        Log::error(TEXT("SetWindowPos failed: %lu\n"), ex.code);
+        Perf::bump(Perf::Counter::SetWindowPosFailures);
+      }
+    }
+    moves = std::move(succeeded);
+  }
+
+  for (auto i : moves) {
+    // 予想のクライアント領域は、ウィンドウ全体の左上からの相対位置が変わらないものとする
+    auto &ts = *visibles[i];
+    auto const &rc = rects[i];
+    auto ncX = ts.windowRect.left - ts.clientRect.left;
+    auto ncY = ts.windowRect.top - ts.clientRect.top;
+    auto cW = Win32::width(rc) - tiles[i].ncW;
+    auto cH = Win32::height(rc) - tiles[i].ncH;
+    ts.update_after_move(rc, RECT{rc.left - ncX, rc.top - ncY, rc.left - ncX + cW, rc.top - ncY + cH}, guards[ts.window.get()]);
+  }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace Umapita::Tiling {
+
+//
+// 複数のターゲットウィンドウのタイル配置
+//
+// 矩形の計算は umapita_tiling_solver.h の solve() で行い、ここでは実際にウィンドウを動かす。
+// 並べたブロック全体は PerOrientation の origin と offsetX, offsetY に従って配置する。
+//
+
+// targets をまとめて配置し、動かしたものは windowRect, clientRect を読み直した実際の値に更新する。
+// 配置に使うモニタ・タスクバーの扱い・原点は先頭のターゲットの向きの設定に従う。
+// guards のそのウィンドウのガードが止めているもの（取り合い中・これ以上近づけない）は動かさない。
+void apply(const UmapitaMonitors &monitors, const UmapitaSetting::PerProfile &profile, std::vector<TargetStatus> &targets,
+           ConvergenceGuards &guards);
+
+} // namespace Umapita::Tiling
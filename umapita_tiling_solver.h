@@ -0,0 +1,192 @@
+#pragma once
+
+namespace Umapita::Tiling {
+
+//
+// タイル配置の矩形の計算
+//
+// ウィンドウを縦横比の順（横長のものから。同じなら非クライアント領域の小さいものから）に並べ直し、
+// その順のまま何行か（または何列か）に区切って並べる配置をすべて試して、重ならずにクライアント領域の総面積が最大になるものを選ぶ。
+// 並べ直した順で連続する区切り方だけを探すヒューリスティックなので、あらゆる割り当ての中での最適とは限らないが、
+// 結果はウィンドウの列挙順（ハンドルの値）に左右されない。
+// 同じ行のウィンドウはクライアント領域の高さを揃え、行が領域に収まらないときは全部の行を同じ倍率で縮める。
+//
+// 標準ライブラリだけで書いてあるので tests/ からも使う。
+// 候補の数はタイルが一つ増えるごとに倍になり、tests/bench_tiling では MAX_TILES 個で 1 回 0.2ms ほどかかる。
+//
+constexpr std::size_t MAX_TILES = 10;  // 配置の候補は 2 * 2^(n-1) 通り
+
+struct Tile {
+  LONG aspectX, aspectY;  // クライアント領域の縦横比
+  LONG ncW, ncH;          // 非クライアント領域の幅と高さ（両サイドの和）
+};
+
+namespace Detail {
+
+// 長さ len の中に幅 w のものを align に従って置いたときの開始位置
+inline LONG align_in(LONG len, LONG w, int align) {
+  return align < 0 ? 0 : align > 0 ? len - w : len/2 - w/2;
+}
+
+struct Layout {
+  LONGLONG clientArea = -1;  // 収まらなければ負
+  LONG width = 0, height = 0;
+};
+
+// 行の高さを切り捨てるときに、丸め誤差で 1 ピクセル欠けないように足す
+constexpr double EPSILON = 1e-6;
+
+//
+// tiles を先頭から順に行に分けて W x H に並べる
+// breaks のビット i が立っていれば i 番目のタイルの後で改行する。
+// rects が nullptr でなければ、ブロック左上を原点としたウィンドウ全体の矩形を書き込む
+//
+inline Layout layout_rows(const Tile *tiles, std::size_t n, unsigned breaks, LONG W, LONG H, int align, RECT *rects) {
+  struct Row {
+    std::size_t first, last;
+    double aspect;  // 行のクライアント領域の幅 / 高さ
+    LONG ncW, ncH;
+    double cap;     // 幅いっぱいにしたときのクライアント領域の高さ
+    LONG ch;
+  };
+  std::array<Row, MAX_TILES> rows;
+  std::size_t numRows = 0;
+
+  for (std::size_t i=0; i<n; i++) {
+    if (i == 0 || (breaks & (1U << (i-1))))
+      rows[numRows++] = Row{i, i, 0., 0, 0, 0., 0};
+    auto &r = rows[numRows-1];
+    r.last = i+1;
+    r.aspect += static_cast<double>(tiles[i].aspectX) / tiles[i].aspectY;
+    r.ncW += tiles[i].ncW;
+    r.ncH = std::max(r.ncH, tiles[i].ncH);
+  }
+
+  // 各行を幅いっぱいにしたときの高さを求め、縦に収まらなければ全部の行を同じ倍率で縮める
+  double sumCH = 0;
+  LONG sumNcH = 0;
+  for (std::size_t k=0; k<numRows; k++) {
+    auto cap = (W - rows[k].ncW) / rows[k].aspect;
+    if (cap <= 0)
+      return {};
+    sumCH += cap;
+    sumNcH += rows[k].ncH;
+    rows[k].cap = cap;
+  }
+  if (H - sumNcH <= 0)
+    return {};
+  auto scale = std::min(1., (H - sumNcH) / sumCH);
+
+  Layout ret{0, 0, 0};
+  for (std::size_t k=0; k<numRows; k++) {
+    auto &r = rows[k];
+    // 行数 * EPSILON < 1 なので、切り捨てた和は H を超えない
+    r.ch = static_cast<LONG>(r.cap * scale + EPSILON);
+    if (r.ch <= 0)
+      return {};
+    LONG x = 0;
+    for (auto i=r.first; i<r.last; i++) {
+      auto const &t = tiles[i];
+      auto cw = t.aspectX * r.ch / t.aspectY;
+      if (cw <= 0)
+        return {};
+      if (rects)
+        rects[i] = RECT{x, ret.height, x + cw + t.ncW, ret.height + r.ch + t.ncH};
+      x += cw + t.ncW;
+      ret.clientArea += static_cast<LONGLONG>(cw) * r.ch;
+    }
+    ret.width = std::max(ret.width, x);
+    ret.height += r.ch + r.ncH;
+  }
+
+  // 行ごとに横方向の位置を揃える
+  if (rects) {
+    for (std::size_t k=0; k<numRows; k++) {
+      auto const &r = rows[k];
+      auto dx = align_in(ret.width, rects[r.last-1].right, align);
+      for (auto i=r.first; i<r.last; i++) {
+        rects[i].left += dx;
+        rects[i].right += dx;
+      }
+    }
+  }
+  return ret;
+}
+
+inline RECT transpose(const RECT &rc) {
+  return RECT{rc.top, rc.left, rc.bottom, rc.right};
+}
+
+} // namespace Detail
+
+// area にタイルを並べたときの各ウィンドウ全体の矩形を tiles の順に返す。
+// 並べたブロック全体は hAlign, vAlign（-1: 西/北, 0: 中央, 1: 東/南）の側に寄せ、offsetX, offsetY だけ内側にずらす。
+// 先頭の MAX_TILES 個までしか並べない（呼び出し側で先に減らしておくこと）。どう並べても収まらなければ空を返す。
+inline std::vector<RECT> solve(const std::vector<Tile> &tiles, const RECT &area, int hAlign, int vAlign, LONG offsetX, LONG offsetY) {
+  using namespace Detail;
+  auto n = std::min(tiles.size(), MAX_TILES);
+  if (n == 0)
+    return {};
+  auto W = area.right - area.left, H = area.bottom - area.top;
+
+  for (std::size_t i=0; i<n; i++)
+    if (tiles[i].aspectX <= 0 || tiles[i].aspectY <= 0)
+      return {};
+
+  // 横長のものから並べる。同じ縦横比のものが同じ行に集まりやすく、行の高さが揃う。
+  // 縦横比が同じなら非クライアント領域の大きさで決め、区別のつかないものだけがもとの順に残るようにする
+  std::array<std::size_t, MAX_TILES> order;
+  for (std::size_t i=0; i<n; i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.begin() + n, [&tiles](auto lhs, auto rhs) {
+                                                       auto const &l = tiles[lhs], &r = tiles[rhs];
+                                                       auto la = static_cast<LONGLONG>(l.aspectX) * r.aspectY, ra = static_cast<LONGLONG>(r.aspectX) * l.aspectY;
+                                                       return la != ra ? la > ra : std::tie(l.ncW, l.ncH) < std::tie(r.ncW, r.ncH);
+                                                     });
+
+  // 列に分けて並べる場合は縦横を入れ替えて行に並べる問題として解く
+  std::array<Tile, MAX_TILES> rowTiles, columnTiles;
+  for (std::size_t k=0; k<n; k++) {
+    auto const &t = tiles[order[k]];
+    rowTiles[k] = t;
+    columnTiles[k] = Tile{t.aspectY, t.aspectX, t.ncH, t.ncW};
+  }
+
+  Layout best;
+  unsigned bestBreaks = 0;
+  auto isBestColumns = false;
+  for (unsigned breaks=0; breaks < (1U << (n-1)); breaks++) {
+    if (auto l = layout_rows(rowTiles.data(), n, breaks, W, H, hAlign, nullptr); l.clientArea > best.clientArea) {
+      best = l;
+      bestBreaks = breaks;
+      isBestColumns = false;
+    }
+    if (auto l = layout_rows(columnTiles.data(), n, breaks, H, W, vAlign, nullptr); l.clientArea > best.clientArea) {
+      best = Layout{l.clientArea, l.height, l.width};
+      bestBreaks = breaks;
+      isBestColumns = true;
+    }
+  }
+  if (best.clientArea < 0)
+    return {};
+
+  std::array<RECT, MAX_TILES> sorted;
+  if (isBestColumns) {
+    layout_rows(columnTiles.data(), n, bestBreaks, H, W, vAlign, sorted.data());
+    for (std::size_t k=0; k<n; k++)
+      sorted[k] = transpose(sorted[k]);
+  } else
+    layout_rows(rowTiles.data(), n, bestBreaks, W, H, hAlign, sorted.data());
+
+  // ブロック全体を TargetStatus::adjust と同じ考え方で原点に対して配置し、tiles の順に戻す
+  auto bx = area.left + align_in(W, best.width, hAlign) + (hAlign > 0 ? -offsetX : offsetX);
+  auto by = area.top + align_in(H, best.height, vAlign) + (vAlign > 0 ? -offsetY : offsetY);
+  std::vector<RECT> rects(n);
+  for (std::size_t k=0; k<n; k++) {
+    auto const &rc = sorted[k];
+    rects[order[k]] = RECT{rc.left + bx, rc.top + by, rc.right + bx, rc.bottom + by};
+  }
+  return rects;
+}
+
+} // namespace Umapita::Tiling
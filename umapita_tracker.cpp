@@ -0,0 +1,356 @@
+#include "pch.h"
+#include "am/win32util.h"
+#include "umapita_def.h"
+#include "umapita_monitor_index.h"
+#include "umapita_monitors.h"
+#include "umapita_setting.h"
+#include "umapita_registry.h"
+#include "umapita_target_status.h"
+#include "umapita_hot_key.h"
+#include "umapita_perf_counters.h"
+#include "umapita_convergence_guard.h"
+#include "umapita_tiling.h"
+#include "umapita_scheduler.h"
+#include "umapita_tracker.h"
+
+using namespace Umapita;
+using namespace AM;
+using Win32::Window;
+
+namespace {
+
+Perf::Counter state_counter(TargetState state) {
+  switch (state) {
+  case TargetState::Normal:
+    return Perf::Counter::TargetNormalMillis;
+  case TargetState::Minimized:
+    return Perf::Counter::TargetMinimizedMillis;
+  case TargetState::Fullscreen:
+    return Perf::Counter::TargetFullscreenMillis;
+  case TargetState::Cloaked:
+    return Perf::Counter::TargetCloakedMillis;
+  default:
+    return Perf::Counter::TargetAbsentMillis;
+  }
+}
+
+LPCTSTR state_name(TargetState state) {
+  switch (state) {
+  case TargetState::Normal:
+    return TEXT("normal");
+  case TargetState::Minimized:
+    return TEXT("minimized");
+  case TargetState::Fullscreen:
+    return TEXT("fullscreen");
+  case TargetState::Cloaked:
+    return TEXT("cloaked");
+  default:
+    return TEXT("absent");
+  }
+}
+
+} // namespace
+
+void Tracker::load_global_setting() {
+  m_setting = UmapitaRegistry::load_global_setting();
+  reload_hot_keys();
+}
+
+void Tracker::save_global_setting() const {
+  UmapitaRegistry::save_global_setting(m_setting);
+}
+
+void Tracker::load_profile(Win32::StrPtr name) {
+  m_setting.common.currentProfileName = name.ptr;
+  m_setting.currentProfile = UmapitaRegistry::load_setting(name);
+  m_setting.common.isCurrentProfileChanged = false;
+  invalidate();
+}
+
+void Tracker::reload_hot_keys() {
+  m_hotKeys.set_bindings(HotKeyTable::parse(m_setting.common.hotKeys));
+  // 次の tick で差分が OS に反映される
+  invalidate();
+}
+
+void Tracker::nudge(LONG dx, LONG dy) {
+  auto &profile = m_setting.currentProfile;
+  if (!m_lastTargetStatus.window || profile.isLocked)
+    return;
+
+  auto isHorizontal = Win32::width(m_lastTargetStatus.clientRect) > Win32::height(m_lastTargetStatus.clientRect);
+  auto &s = isHorizontal ? profile.horizontal : profile.vertical;
+  // 東側・南側が原点のときはオフセットの向きが逆になる
+  switch (s.origin) {
+  case UmapitaSetting::PerOrientation::NE:
+  case UmapitaSetting::PerOrientation::E:
+  case UmapitaSetting::PerOrientation::SE:
+    s.offsetX -= dx;
+    break;
+  default:
+    s.offsetX += dx;
+    break;
+  }
+  switch (s.origin) {
+  case UmapitaSetting::PerOrientation::SW:
+  case UmapitaSetting::PerOrientation::S:
+  case UmapitaSetting::PerOrientation::SE:
+    s.offsetY -= dy;
+    break;
+  default:
+    s.offsetY += dy;
+    break;
+  }
+  m_setting.common.isCurrentProfileChanged = true;
+  invalidate();
+}
+
+void Tracker::reset_monitors() {
+  Log::debug(TEXT("reset monitors"));
+  m_monitors = UmapitaMonitors{};
+  Perf::bump(Perf::Counter::MonitorResets);
+  invalidate();
+}
+
+TargetState Tracker::classify_last() const {
+  if (!m_setting.common.isTilingMode || m_lastTiledStatus.empty())
+    return m_lastTargetStatus.state;
+  for (auto const &ts : m_lastTiledStatus)
+    if (ts.state == TargetState::Normal)
+      return ts.state;
+  return m_lastTargetStatus.state;
+}
+
+void Tracker::reclassify_last() {
+  m_lastTargetStatus.state = TargetStatus::classify(m_lastTargetStatus.window);
+  for (auto &ts : m_lastTiledStatus)
+    ts.state = ts.window == m_lastTargetStatus.window ? m_lastTargetStatus.state : TargetStatus::classify(ts.window);
+}
+
+void Tracker::update_target_state(TargetState state) {
+  auto now = GetTickCount64();
+  Perf::bump(state_counter(m_targetState), now - m_targetStateSince);
+  m_targetStateSince = now;
+  if (state == m_targetState)
+    return;
+  Log::info(TEXT("target state: %ls -> %ls"), state_name(m_targetState), state_name(state));
+  m_targetState = state;
+}
+
+TargetChangeMask Tracker::tick(Window host) {
+  Perf::bump(Perf::Counter::Ticks);
+  // 休止中は前回のターゲットの状態だけを確かめ、まだ休止すべきならそれ以上何もしない
+  if (is_dormant() && !m_isInvalidated) {
+    reclassify_last();
+    update_target_state(classify_last());
+    if (is_dormant())
+      return TargetChange::None;
+    // 休止中に変わった分は配置していないので、見た目の変化がなくても配置し直す
+    invalidate();
+  }
+  if (m_isInvalidated) {
+    m_lastTargetStatus = TargetStatus{};
+    m_lastTiledStatus.clear();
+    m_isInvalidated = false;
+  }
+  auto changes = TargetChange::None;
+  if (m_setting.common.isTilingMode) {
+    changes = tick_tiling();
+  } else {
+    auto ts = TargetStatus::get(TARGET_WINDOW_CLASS, TARGET_WINDOW_NAME);
+    Perf::bump(Perf::Counter::TargetLookups);
+    changes = diff(m_lastTargetStatus, ts);
+    if (changes == TargetChange::None) {
+      Perf::bump(Perf::Counter::TargetCacheHits);
+      return changes;
+    }
+
+    m_lastTargetStatus = ts;
+    prune_convergence();
+    update_target_state(classify_last());
+    // 終了の通知を取りこぼしたままターゲットが変わったら、ドラッグ中の扱いをやめる
+    if (m_moveSizeWindow && !(m_moveSizeWindow == ts.window))
+      m_moveSizeWindow = Window{};
+    if (is_layout_needed(changes))
+      m_lastTargetStatus.adjust(m_monitors, m_setting.currentProfile, m_convergence[ts.window.get()]);
+  }
+  schedule_backoff_expiry();
+  if (changes == TargetChange::None)
+    return changes;
+  // ホットキーの調整（差分だけが OS に反映される）。位置や大きさが変わっただけなら見なくてよい
+  if (changes & (TargetChange::Identity | TargetChange::Focus))
+    arm_hot_keys(host);
+  return changes;
+}
+
+void Tracker::arm_hot_keys(Window host) {
+  auto const &ts = m_lastTargetStatus;
+  if (!ts.window || ts.isFocusOn) {
+    m_scheduler.cancel(m_hotKeyReleaseTask);
+    m_hotKeys.arm(host, ts.window && ts.isFocusOn, m_setting.common.isEnabled);
+    return;
+  }
+  // alt-tab で行き来するたびに登録し直さないように、しばらくは登録したままにしておく
+  if (!m_scheduler.is_scheduled(m_hotKeyReleaseTask))
+    m_hotKeyReleaseTask = m_scheduler.schedule_once(HOT_KEY_RELEASE_DELAY, HOT_KEY_RELEASE_DELAY / 2,
+                                                    [this, host] { release_hot_keys(host); });
+}
+
+void Tracker::release_hot_keys(Window host) {
+  m_scheduler.cancel(m_hotKeyReleaseTask);
+  auto const &ts = m_lastTargetStatus;
+  m_hotKeys.arm(host, ts.window && ts.isFocusOn, m_setting.common.isEnabled);
+}
+
+bool Tracker::is_layout_needed(TargetChangeMask changes) {
+  if (changes == TargetChange::Focus) {
+    // alt-tab などでフォーカスが出入りしただけなら、配置は変わらない
+    Perf::bump(Perf::Counter::FocusOnlyChanges);
+    Perf::bump(Perf::Counter::LayoutPassesAvoided);
+    return false;
+  }
+  if (m_moveSizeWindow) {
+    Perf::bump(Perf::Counter::MoveSizeSuppressions);
+    Perf::bump(Perf::Counter::LayoutPassesAvoided);
+    return false;
+  }
+  if (!m_setting.common.isEnabled || is_dormant()) {
+    Perf::bump(Perf::Counter::LayoutPassesAvoided);
+    return false;
+  }
+  return true;
+}
+
+TargetChangeMask Tracker::tick_tiling() {
+  auto all = TargetStatus::get_all(TARGET_WINDOW_CLASS, TARGET_WINDOW_NAME);
+  Perf::bump(Perf::Counter::TargetLookups);
+  auto changes = diff(m_lastTiledStatus, all);
+  if (changes == TargetChange::None) {
+    Perf::bump(Perf::Counter::TargetCacheHits);
+    return changes;
+  }
+
+  m_lastTiledStatus = std::move(all);
+  auto previous = m_lastTargetStatus.window;
+  // ダイアログの表示とホットキーはフォーカスのあるもの（なければ先頭）を代表にする
+  auto focused = std::find_if(m_lastTiledStatus.begin(), m_lastTiledStatus.end(), [](auto const &ts) { return ts.isFocusOn; });
+  m_lastTargetStatus = focused != m_lastTiledStatus.end() ? *focused :
+                       !m_lastTiledStatus.empty() ? m_lastTiledStatus.front() : TargetStatus{};
+  prune_convergence();
+  update_target_state(classify_last());
+  if (m_moveSizeWindow &&
+      std::none_of(m_lastTiledStatus.begin(), m_lastTiledStatus.end(), [this](auto const &ts) { return ts.window == m_moveSizeWindow; }))
+    m_moveSizeWindow = Window{};
+  if (is_layout_needed(changes)) {
+    // 一つしかなければ普段どおりプロファイルに従って配置する
+    if (m_lastTiledStatus.size() == 1)
+      m_lastTiledStatus.front().adjust(m_monitors, m_setting.currentProfile, m_convergence[m_lastTiledStatus.front().window.get()]);
+    else
+      Tiling::apply(m_monitors, m_setting.currentProfile, m_lastTiledStatus, m_convergence);
+    // 配置後の矩形を代表にも反映する
+    if (auto it = std::find_if(m_lastTiledStatus.begin(), m_lastTiledStatus.end(),
+                               [this](auto const &ts) { return ts.window == m_lastTargetStatus.window; });
+        it != m_lastTiledStatus.end())
+      m_lastTargetStatus = *it;
+  }
+  // 代表が入れ替わっただけでも、表示とホットキーにとっては別のウィンドウになる
+  return m_lastTargetStatus.window == previous ? changes : changes | TargetChange::Identity;
+}
+
+void Tracker::prune_convergence() {
+  auto is_alive = [this](HWND hWnd) {
+                    if (m_setting.common.isTilingMode)
+                      return std::any_of(m_lastTiledStatus.begin(), m_lastTiledStatus.end(),
+                                         [hWnd](auto const &ts) { return ts.window.get() == hWnd; });
+                    return m_lastTargetStatus.window.get() == hWnd;
+                  };
+  for (auto it=m_convergence.begin(); it!=m_convergence.end(); ) {
+    if (is_alive(it->first))
+      ++it;
+    else
+      it = m_convergence.erase(it);
+  }
+}
+
+void Tracker::schedule_backoff_expiry() {
+  std::optional<ULONGLONG> until;
+  for (auto const &[hWnd, guard] : m_convergence)
+    if (guard.state() == ConvergenceGuard::BackingOff)
+      until = std::min(until.value_or(guard.backoff_until()), guard.backoff_until());
+  if (!until) {
+    m_scheduler.cancel(m_backoffTask);
+    return;
+  }
+  if (m_scheduler.is_scheduled(m_backoffTask) && m_backoffTaskAt == *until)
+    return;
+  m_scheduler.cancel(m_backoffTask);
+  auto now = GetTickCount64();
+  m_backoffTaskAt = *until;
+  m_backoffTask = m_scheduler.schedule_once(*until > now ? *until - now : 0, CONVERGENCE_RETRY_SLACK, [this] { on_backoff_expired(); });
+}
+
+void Tracker::on_backoff_expired() {
+  auto now = GetTickCount64();
+  auto isExpired = false;
+  for (auto &[hWnd, guard] : m_convergence)
+    isExpired = guard.poll_backoff_expired(now) || isExpired;
+  // 時計の刻みの違いでまだ明けていなければ、ここで入れ直す
+  schedule_backoff_expiry();
+  if (!isExpired)
+    return;
+  // 配置の取り合いで一時停止していたので、明けたところで一度だけやり直してみる
+  invalidate();
+  m_requestTick();
+}
+
+ConvergenceGuard::State Tracker::convergence_state() const {
+  auto it = m_convergence.find(m_lastTargetStatus.window.get());
+  return it != m_convergence.end() ? it->second.state() : ConvergenceGuard::Idle;
+}
+
+void Tracker::disarm_hot_keys(Window host) {
+  m_scheduler.cancel(m_hotKeyReleaseTask);
+  m_hotKeys.disarm_all(host);
+}
+
+void Tracker::begin_move_size(HWND hWnd) {
+  auto isTarget = m_setting.common.isTilingMode ?
+    std::any_of(m_lastTiledStatus.begin(), m_lastTiledStatus.end(), [hWnd](auto const &ts) { return ts.window.get() == hWnd; }) :
+    m_lastTargetStatus.window.get() == hWnd;
+  if (!isTarget)
+    return;
+  try {
+    m_moveSizeStartRect = Window{hWnd}.get_window_rect();
+  }
+  catch (Win32::Win32ErrorCode &) {
+    return;
+  }
+  Log::debug(TEXT("%p: move/size loop started"), hWnd);
+  m_moveSizeWindow = Window{hWnd};
+}
+
+bool Tracker::end_move_size(HWND hWnd, bool isAdoptPosition) {
+  if (!m_moveSizeWindow || m_moveSizeWindow.get() != hWnd)
+    return false;
+  Log::debug(TEXT("%p: move/size loop ended"), hWnd);
+  m_moveSizeWindow = Window{};
+  invalidate();
+
+  // タイル配置のときは位置をソルバが決めるので取り込まない
+  if (!isAdoptPosition || m_setting.common.isTilingMode || m_setting.currentProfile.isLocked)
+    return false;
+  RECT rect;
+  try {
+    rect = Window{hWnd}.get_window_rect();
+  }
+  catch (Win32::Win32ErrorCode &) {
+    return false;
+  }
+  if (Win32::width(rect) != Win32::width(m_moveSizeStartRect) || Win32::height(rect) != Win32::height(m_moveSizeStartRect) ||
+      (rect.left == m_moveSizeStartRect.left && rect.top == m_moveSizeStartRect.top))
+    return false;
+  // ドラッグ前の位置（配置済みのはず）からの移動量をそのままオフセットに足す
+  nudge(rect.left - m_moveSizeStartRect.left, rect.top - m_moveSizeStartRect.top);
+  Log::info(TEXT("adopted dropped position: (%ld,%ld)"), rect.left, rect.top);
+  return true;
+}
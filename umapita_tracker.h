@@ -0,0 +1,90 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// ターゲットウィンドウの監視と配置
+//
+// ダイアログの有無に関係なく常駐し、設定・モニタ・ターゲットの状態・ホットキーを保持する
+//
+class Tracker {
+  Scheduler &m_scheduler;
+  Scheduler::Task m_requestTick;  // 次の周期を待たずに tick してもらう
+  UmapitaSetting::Global m_setting{UmapitaSetting::DEFAULT_GLOBAL.clone<AM::Win32::tstring>()};
+  UmapitaMonitors m_monitors;
+  TargetStatus m_lastTargetStatus;
+  std::vector<TargetStatus> m_lastTiledStatus;  // タイル配置モードのときだけ使う
+  bool m_isInvalidated = true;
+  HotKeyTable m_hotKeys;
+  Scheduler::TaskId m_hotKeyReleaseTask = 0;
+  ConvergenceGuards m_convergence;  // 今見えているターゲットのものだけを持つ
+  Scheduler::TaskId m_backoffTask = 0;
+  ULONGLONG m_backoffTaskAt = 0;  // m_backoffTask を実行する GetTickCount64() の時刻
+  AM::Win32::Window m_moveSizeWindow;  // ユーザがドラッグ・リサイズ中のターゲット
+  RECT m_moveSizeStartRect{0, 0, 0, 0};
+  TargetState m_targetState = TargetState::Absent;
+  ULONGLONG m_targetStateSince = GetTickCount64();
+
+  TargetChangeMask tick_tiling();
+  // 変化の種類 changes に対して配置し直す必要があるか
+  bool is_layout_needed(TargetChangeMask changes);
+  // 最後に見たターゲットの状態。タイル配置のときは一つでも Normal なら Normal
+  TargetState classify_last() const;
+  // 休止中はターゲットを探さないので、最後に見たものの状態だけを調べ直す
+  void reclassify_last();
+  // 前回からの経過時間を前の状態の累積時間に足して、状態を切り替える
+  void update_target_state(TargetState state);
+  // フォーカスが来たらすぐにホットキーを登録し、外れたら HOT_KEY_RELEASE_DELAY だけ待ってから外す。
+  // その間に押されたものは、ホストが登録を外して前面のアプリに送り直す
+  void arm_hot_keys(AM::Win32::Window host);
+  // もういないウィンドウの収束ガードを捨てる
+  void prune_convergence();
+  // 一番早くバックオフが明ける時刻に、やり直しの予定を一つだけ入れる（引いているものがなければ取り消す）
+  void schedule_backoff_expiry();
+  void on_backoff_expired();
+
+public:
+  Tracker(Scheduler &scheduler, Scheduler::Task requestTick) : m_scheduler{scheduler}, m_requestTick{std::move(requestTick)} { }
+  ~Tracker() {
+    m_scheduler.cancel(m_backoffTask);
+    m_scheduler.cancel(m_hotKeyReleaseTask);
+  }
+  Tracker(const Tracker &) = delete;
+  Tracker &operator = (const Tracker &) = delete;
+  UmapitaSetting::Global &setting() { return m_setting; }
+  const UmapitaSetting::Global &setting() const { return m_setting; }
+  UmapitaMonitors &monitors() { return m_monitors; }
+  const TargetStatus &last_target_status() const { return m_lastTargetStatus; }
+  HotKeyTable &hot_keys() { return m_hotKeys; }
+  // 代表のターゲットの収束ガードの状態
+  ConvergenceGuard::State convergence_state() const;
+  TargetState target_state() const { return m_targetState; }
+  // 最小化・排他的全画面・クローク中は配置せず、tick でもターゲットを探さない
+  bool is_dormant() const {
+    return m_targetState == TargetState::Minimized || m_targetState == TargetState::Fullscreen || m_targetState == TargetState::Cloaked;
+  }
+
+  void load_global_setting();
+  void save_global_setting() const;
+  void load_profile(AM::Win32::StrPtr name);
+  // setting().common.hotKeys を解析してホットキーのテーブルに反映する
+  void reload_hot_keys();
+  // 現在の向きのオフセットをずらす（ロックされていれば何もしない）
+  void nudge(LONG dx, LONG dy);
+  // 設定が変更されたので次の tick で必ず再配置する
+  void invalidate() { m_isInvalidated = true; }
+  void reset_monitors();
+  // ターゲットの状態を調べて必要なら再配置する。前回からの変化の種類を返す
+  TargetChangeMask tick(AM::Win32::Window host);
+  void disarm_hot_keys(AM::Win32::Window host);
+  // 猶予を待たずにフォーカスがないときの状態にする
+  void release_hot_keys(AM::Win32::Window host);
+  // ターゲットのドラッグ・リサイズが始まった。終わるまで配置しない
+  void begin_move_size(HWND hWnd);
+  // ドラッグ・リサイズが終わった。次の tick で一度だけ配置する。
+  // isAdoptPosition なら動かした量をオフセットに取り込む（サイズを変えずに動かした場合だけ）。取り込んだら true を返す
+  bool end_move_size(HWND hWnd, bool isAdoptPosition);
+  bool is_in_move_size() const { return !!m_moveSizeWindow; }
+};
+
+} // namespace Umapita
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace Umapita {
+
+//
+// SetWinEventHook のハンドルを持つだけのもの
+//
+// WINEVENT_OUTOFCONTEXT なので、コールバックはフックを掛けたスレッドのメッセージループの中で呼ばれる
+//
+class WinEventHook {
+  HWINEVENTHOOK m_hHook = nullptr;
+
+public:
+  WinEventHook() = default;
+  // processId が 0 ならすべてのプロセスのイベントを受け取る
+  WinEventHook(DWORD eventMin, DWORD eventMax, WINEVENTPROC proc, DWORD processId = 0)
+    : m_hHook{SetWinEventHook(eventMin, eventMax, nullptr, proc, processId, 0,
+                              WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS)} {
+    if (!m_hHook)
+      AM::Log::warning(TEXT("SetWinEventHook(%lX-%lX) failed"), eventMin, eventMax);
+  }
+  ~WinEventHook() {
+    if (m_hHook)
+      UnhookWinEvent(m_hHook);
+  }
+  WinEventHook(WinEventHook &&rhs) noexcept : m_hHook{std::exchange(rhs.m_hHook, nullptr)} { }
+  WinEventHook &operator = (WinEventHook &&rhs) noexcept {
+    std::swap(m_hHook, rhs.m_hHook);
+    return *this;
+  }
+  explicit operator bool () const { return m_hHook != nullptr; }
+};
+
+} // namespace Umapita